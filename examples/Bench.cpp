@@ -0,0 +1,612 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2009, 2010 Alin Murarasu
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+/*
+ * Benchmark suite for the sparse grid routines.
+ *
+ * Times construction, hierarchization, single point and batch evaluation and the
+ * Converter round-trips over a matrix of (d, l, batch size, threads). Every measurement
+ * runs once to warm up and then -k times (5 by default); the median is reported together
+ * with the spread of the runs. Results are printed as a table and optionally written as
+ * JSON (one record per line). When a baseline JSON file is given, every record is compared
+ * against it and the program exits with status 1 if any of them got slower by more than
+ * the tolerance, or by more than the spread of the two measurements if that is larger.
+ *
+ * Usage: bench [-d 2,4,6] [-l 4,6] [-b 1,64,1024] [-t 1,2,4] [-p points]
+ *              [-o out.json] [-c baseline.json] [-r tolerance_percent] [-k repeats] [-q] [-z] [-x] [-n] [-m]
+ *              [-a default|aligned|huge_transparent|huge_2mb|huge_1gb] [-i scalar|sse4.2|avx2|avx512]
+ *
+ * -z benchmarks 0-boundary grids instead of non-0 boundary ones (record names get a _zb suffix).
+ * -x benchmarks grids with the modified linear basis (interior points only, _mod suffix).
+ * -n adds the multi-threaded evaluation under each NUMA policy (evaluate_numa_<policy> records).
+ * -m adds the batch evaluation with the automatic Morton reordering (evaluate_batch_morton records).
+ * The hierarchize_plan record times the hierarchization with a HierarchizationPlan built beforehand.
+ * The evaluate_point records evaluate single points, each one with all threads of the pool (work stealing).
+ * The evaluate_tensor record evaluates a lattice of about npoints points with SparseGrid::evaluateTensor;
+ * evaluate_tensor_batch evaluates the same lattice points with the batch evaluation, for comparison.
+ * -a selects the memory backing the coefficients; the backing obtained is printed for each grid.
+ * -i selects the kernels of an instruction set level instead of the best one (as FSG_ISA does).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+#include "SparseGrid.h"
+#include "Converter.h"
+#include "Helper.h"
+#include "Kernels.h"
+#include "HierarchizationPlan.h"
+#include "Instrumentation.h"
+
+using namespace fsg;
+
+class SampleFct : public Function
+{
+	private:
+		int d;
+
+	public:
+		SampleFct(int d) { this->d = d; }
+
+		int getD() { return d; }
+
+		float getValue(float *coords)
+		{
+			int i;
+			float prod = 1;
+
+			for (i = 0; i < d; i++)
+				prod *= coords[i] * (3 - coords[i]);
+
+			return prod;
+		}
+};
+
+typedef struct bench_record_t {
+	std::string name;
+	int d, l, batch, threads;
+	double ns_per_op;
+	double ops_per_s;
+	double gb_per_s;
+	double spread;		/* (slowest - fastest) / median of the timed runs, in percent */
+} bench_record_t;
+
+typedef struct timing_t {
+	double seconds;		/* median of the timed runs */
+	double spread;		/* (slowest - fastest) / median, in percent */
+} timing_t;
+
+static std::vector<bench_record_t> records;
+static GridType grid_type = GRID_BOUNDARY;
+static int numa = 0;
+static int morton = 0;
+static Allocator *allocator = NULL;
+static int repeats = 5;
+
+/* monotonic wall clock in seconds */
+static double now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * runs op once to warm up and then repeats times, setup (not timed) before each run;
+ * the median is reported as it is not thrown off by a single run disturbed by the system
+ */
+static timing_t measure(const std::function<void()> &op, const std::function<void()> &setup = nullptr)
+{
+	std::vector<double> times;
+	timing_t tm;
+	double t0;
+	int r;
+
+	for (r = 0; r <= repeats; r++) {
+		if (setup)
+			setup();
+		t0 = now();
+		op();
+		if (r > 0)
+			times.push_back(now() - t0);
+	}
+
+	std::sort(times.begin(), times.end());
+	tm.seconds = repeats % 2 ? times[repeats / 2] : (times[repeats / 2 - 1] + times[repeats / 2]) / 2;
+	tm.spread = tm.seconds > 0 ? (times.back() - times.front()) / tm.seconds * 100.0 : 0.0;
+
+	return tm;
+}
+
+/* parses a comma separated list of positive integers */
+static std::vector<int> parse_list(const char *s)
+{
+	std::vector<int> v;
+	char *end;
+
+	while (*s) {
+		v.push_back((int) strtol(s, &end, 10));
+		if (*end != ',')
+			break;
+		s = end + 1;
+	}
+
+	return v;
+}
+
+/* number of subspaces (regular grids) of a non-0 boundary sparse grid; one coefficient of each is read per evaluation */
+static long num_subspaces(int d, int l)
+{
+	int pd;
+	long s = 0;
+
+	if (grid_type != GRID_BOUNDARY)
+		return Helper::combi(d - 1 + l, l - 1);
+
+	for (pd = 0; pd <= d; pd++)
+		s += (long) (1 << (d - pd)) * Helper::combi(d, pd) * (pd ? Helper::combi(pd - 1 + l, l - 1) : 1);
+
+	return s;
+}
+
+static void report(const char *name, int d, int l, int batch, int threads, const timing_t &tm, double ops, double bytes)
+{
+	bench_record_t r;
+
+	r.name = name;
+	if (grid_type == GRID_ZERO_BOUNDARY)
+		r.name += "_zb";
+	else if (grid_type == GRID_MODIFIED)
+		r.name += "_mod";
+	r.d = d;
+	r.l = l;
+	r.batch = batch;
+	r.threads = threads;
+	r.ns_per_op = tm.seconds * 1e9 / ops;
+	r.ops_per_s = ops / tm.seconds;
+	r.gb_per_s = bytes / tm.seconds * 1e-9;
+	r.spread = tm.spread;
+	records.push_back(r);
+
+	printf("%-16s d=%-2d l=%-2d batch=%-6d threads=%-3d %12.1f ns/op %14.0f ops/s %8.3f GB/s %6.1f%% spread\n",
+		r.name.c_str(), d, l, batch, threads, r.ns_per_op, r.ops_per_s, r.gb_per_s, r.spread);
+}
+
+/* prints the counters gathered since the last reset if the library is instrumented */
+static void report_instrumentation(const char *name, int op)
+{
+	inst_stats_t st;
+	unsigned long long total, seen = 0, p50 = 0, p99 = 0;
+	int b;
+
+	if (Instrumentation::snapshot(&st))
+		return;
+
+	total = st.counters[INST_CYCLES_SETUP] + st.counters[INST_CYCLES_HATS] + st.counters[INST_CYCLES_GATHER];
+	if (total == 0)
+		total = 1;
+	for (b = 0; b < INST_HISTOGRAM_BUCKETS && st.calls[op]; b++) {
+		seen += st.histogram[op][b];
+		if (!p50 && seen * 2 >= st.calls[op])
+			p50 = 1ULL << (b + 1);
+		if (!p99 && seen * 100 >= st.calls[op] * 99)
+			p99 = 1ULL << (b + 1);
+	}
+
+	printf("  %-14s subspaces=%llu coefficients=%llu conversions=%llu setup=%.1f%% hats=%.1f%% gather=%.1f%% "
+		"p50<%llu ns p99<%llu ns\n", name,
+		st.counters[INST_SUBSPACES], st.counters[INST_COEFFICIENTS], st.counters[INST_CONVERSIONS],
+		100.0 * st.counters[INST_CYCLES_SETUP] / total, 100.0 * st.counters[INST_CYCLES_HATS] / total,
+		100.0 * st.counters[INST_CYCLES_GATHER] / total, p50, p99);
+}
+
+/* evaluates npoints points in batches of size bs, the batches being split over nthreads threads */
+static void evaluate_batches(SparseGrid *sg, float *coords, int npoints, int bs, int nthreads)
+{
+	int d = sg->getD();
+	std::vector<std::thread> workers;
+	int nbatches = (npoints + bs - 1) / bs;
+	int t;
+
+	for (t = 0; t < nthreads; t++)
+		workers.push_back(std::thread([=]() {
+			float vals[bs];
+			int b, n;
+
+			for (b = t; b < nbatches; b += nthreads) {
+				n = (b + 1) * bs > npoints ? npoints - b * bs : bs;
+				if (n == 1)
+					vals[0] = sg->evaluate(coords + (long) b * bs * d);
+				else
+					sg->evaluate(coords + (long) b * bs * d, n, vals);
+			}
+		}));
+
+	for (t = 0; t < nthreads; t++)
+		workers[t].join();
+}
+
+static void bench_grid(int d, int l, std::vector<int> &batches, std::vector<int> &threads, int npoints)
+{
+	SampleFct fct(d);
+	timing_t tm;
+	int i, j, n;
+	long sum;
+	long nsub = num_subspaces(d, l);
+	float *coords;
+
+	tm = measure([&]() { SparseGrid g(l, &fct, grid_type, allocator); });
+	SparseGrid sg(l, &fct, grid_type, allocator);
+	n = sg.size();
+	report("construct", d, l, 0, 1, tm, n, (double) n * sizeof(float));
+	if (allocator != NULL)
+		printf("backing: %s, %lu of %lu bytes on huge pages\n", Allocator::name(sg.getBacking()),
+			(unsigned long) sg.getHugePageBytes(), (unsigned long) (n * sizeof(float)));
+
+	/* each of the d sweeps reads the point and its two parents and writes the point */
+	sg.hierarchize();
+	tm = measure([&]() { sg.hierarchize(); }, [&]() { sg.dehierarchize(); });
+	report("hierarchize", d, l, 0, 1, tm, n, (double) n * d * 4 * sizeof(float));
+
+	/* the same transform with a plan made beforehand, as for many grids of one shape */
+	{
+		HierarchizationPlan plan(d, l, grid_type);
+
+		tm = measure([&]() { sg.hierarchize(&plan); }, [&]() { sg.dehierarchize(&plan); });
+		report("hierarchize_plan", d, l, 0, 1, tm, n, (double) n * d * 4 * sizeof(float));
+	}
+
+	sum = 0;
+	tm = measure([&]() {
+		int k, levels[d], indices[d];
+
+		for (k = 0; k < n; k++) {
+			Converter::idx2gp(k, levels, indices, d, l);
+			sum += Converter::gp2idx(levels, indices, d, l) - k;
+		}
+	});
+	if (sum != 0)
+		printf("Converter round-trip is not a bijection!\n");
+	report("convert_li", d, l, 0, 1, tm, n, (double) n * 2 * d * 2 * sizeof(int));
+
+	sum = 0;
+	tm = measure([&]() {
+		int k;
+		float gcoords[d];
+
+		for (k = 0; k < n; k++) {
+			Converter::idx2gp(k, gcoords, d, l);
+			sum += Converter::gp2idx(gcoords, d, l) - k;
+		}
+	});
+	if (sum != 0)
+		printf("Converter coordinate round-trip is not a bijection!\n");
+	report("convert_coord", d, l, 0, 1, tm, n, (double) n * 2 * d * sizeof(float));
+
+	{
+		int *idx = (int *) malloc(n * sizeof(int));
+		int *blev = (int *) malloc((long) n * d * sizeof(int));
+		int *bind = (int *) malloc((long) n * d * sizeof(int));
+		float *bcoords = (float *) malloc((long) n * d * sizeof(float));
+
+		tm = measure([&]() {
+			Converter::bulk_idx2gp(idx, n, blev, bind, d, l);
+			Converter::bulk_li2coord(blev, bind, n, bcoords, d);
+			Converter::bulk_coord2li(bcoords, n, blev, bind, d);
+			Converter::bulk_gp2idx(blev, bind, n, idx, d, l);
+		}, [&]() {
+			for (int k = 0; k < n; k++)
+				idx[k] = k;
+		});
+		for (i = 0; i < n; i++)
+			if (idx[i] != i) {
+				printf("Bulk coordinate round-trip is not a bijection!\n");
+				break;
+			}
+		report("convert_bulk", d, l, 0, 1, tm, n, (double) n * (2 * sizeof(int) + 2 * d * (2 * sizeof(int) + sizeof(float))));
+
+		free(idx);
+		free(blev);
+		free(bind);
+		free(bcoords);
+	}
+
+	coords = (float *) malloc((long) npoints * d * sizeof(float));
+	srand(1);
+	for (i = 0; i < npoints; i++)
+		for (j = 0; j < d; j++)
+			coords[(long) i * d + j] = (float) rand() / RAND_MAX;
+
+	/* the counters are reset before every run, so they describe the last one */
+	tm = measure([&]() {
+		for (int k = 0; k < npoints; k++)
+			sg.evaluate(coords + (long) k * d);
+	}, Instrumentation::reset);
+	report("evaluate", d, l, 1, 1, tm, npoints, (double) npoints * nsub * sizeof(float));
+	report_instrumentation("evaluate", INST_OP_EVALUATE);
+
+	/* single points, each evaluated by a pool of threads */
+	for (j = 0; j < (int) threads.size(); j++) {
+		int np = std::min(npoints, 256), nt = threads[j];
+
+		tm = measure([&]() {
+			for (int k = 0; k < np; k++)
+				sg.evaluate(coords + (long) k * d, nt);
+		});
+		report("evaluate_point", d, l, 1, nt, tm, np, (double) np * nsub * sizeof(float));
+	}
+
+	for (i = 0; i < (int) batches.size(); i++)
+		for (j = 0; j < (int) threads.size(); j++) {
+			tm = measure([&]() { evaluate_batches(&sg, coords, npoints, batches[i], threads[j]); },
+				Instrumentation::reset);
+			report("evaluate_batch", d, l, batches[i], threads[j], tm, npoints,
+				(double) npoints * nsub * sizeof(float));
+			report_instrumentation("evaluate_batch", INST_OP_EVALUATE_BATCH);
+		}
+
+	if (morton) {
+		sg.setReordering(-1);
+		for (i = 0; i < (int) batches.size(); i++) {
+			tm = measure([&]() { evaluate_batches(&sg, coords, npoints, batches[i], 1); });
+			report("evaluate_batch_morton", d, l, batches[i], 1, tm, npoints, (double) npoints * nsub * sizeof(float));
+		}
+		sg.setReordering(0);
+	}
+
+	/* a lattice of about npoints points, evaluated as a tensor product */
+	{
+		int m = (int) (pow((double) npoints, 1.0 / d) + 0.5), total = 1, k;
+		std::vector<float *> axes(d);
+		std::vector<int> sizes(d);
+		std::vector<float> vals;
+
+		if (m < 2)
+			m = 2;
+		for (i = 0; i < d; i++) {
+			sizes[i] = m;
+			axes[i] = coords + (long) i * m;
+			total *= m;
+		}
+		vals.resize(total);
+		tm = measure([&]() { sg.evaluateTensor(&axes[0], &sizes[0], &vals[0]); });
+		/* the coefficients are read once and the lattice is written once */
+		report("evaluate_tensor", d, l, total, 1, tm, total, (double) (nsub + total) * sizeof(float));
+
+		/* the same lattice, as a list of points evaluated in batches of the largest batch size */
+		std::vector<float> points((long) total * d);
+		for (i = 0; i < total; i++)
+			for (j = 0, k = i; j < d; j++) {
+				points[(long) i * d + d - 1 - j] = axes[d - 1 - j][k % m];
+				k /= m;
+			}
+		tm = measure([&]() { evaluate_batches(&sg, &points[0], total, batches.back(), 1); });
+		report("evaluate_tensor_batch", d, l, batches.back(), 1, tm, total, (double) total * nsub * sizeof(float));
+	}
+
+	if (numa) {
+		const char *names[4] = { "evaluate_numa_none", "evaluate_numa_interleave",
+			"evaluate_numa_replicate", "evaluate_numa_partition" };
+		std::vector<float> vals(npoints);
+
+		for (i = 0; i < 4; i++)
+			for (j = 0; j < (int) threads.size(); j++) {
+				if (sg.setNumaPolicy((NumaPolicy) i, threads[j]))
+					printf("%s: placement not enforced, first touch only\n", names[i]);
+				tm = measure([&]() { sg.evaluate(coords, npoints, &vals[0], threads[j]); });
+				report(names[i], d, l, npoints, threads[j], tm, npoints, (double) npoints * nsub * sizeof(float));
+			}
+		sg.setNumaPolicy(NUMA_NONE, 1);
+	}
+
+	free(coords);
+}
+
+static int write_json(const char *path)
+{
+	FILE *f = fopen(path, "w");
+	unsigned i;
+
+	if (!f) {
+		std::cout << "Cannot write " << path << std::endl;
+		return -1;
+	}
+
+	fprintf(f, "[\n");
+	for (i = 0; i < records.size(); i++)
+		fprintf(f, "{\"name\": \"%s\", \"d\": %d, \"l\": %d, \"batch\": %d, \"threads\": %d, "
+			"\"ns_per_op\": %.3f, \"ops_per_s\": %.1f, \"gb_per_s\": %.6f, \"spread\": %.1f}%s\n",
+			records[i].name.c_str(), records[i].d, records[i].l, records[i].batch, records[i].threads,
+			records[i].ns_per_op, records[i].ops_per_s, records[i].gb_per_s, records[i].spread,
+			i + 1 < records.size() ? "," : "");
+	fprintf(f, "]\n");
+	fclose(f);
+
+	return 0;
+}
+
+/*
+ * compares the records against a baseline written by write_json; returns the number of regressions.
+ * Both sides are medians; the tolerance of a record grows to the spread measured now plus the one of the
+ * baseline, so noisy records need a larger change to count.
+ */
+static int compare_baseline(const char *path, double tolerance)
+{
+	FILE *f = fopen(path, "r");
+	char line[512], name[64];
+	int d, l, batch, threads, regressions = 0, matched = 0;
+	double ns, ops, gbs, spread, change, tol;
+	unsigned i;
+
+	if (!f) {
+		std::cout << "Cannot read baseline " << path << std::endl;
+		return 0;
+	}
+
+	printf("\nComparison against baseline %s (tolerance %.1f%%)\n", path, tolerance);
+	while (fgets(line, sizeof(line), f)) {
+		/* baselines written before the spread was recorded have none */
+		spread = 0.0;
+		if (sscanf(line, " {\"name\": \"%63[^\"]\", \"d\": %d, \"l\": %d, \"batch\": %d, \"threads\": %d, "
+				"\"ns_per_op\": %lf, \"ops_per_s\": %lf, \"gb_per_s\": %lf, \"spread\": %lf",
+				name, &d, &l, &batch, &threads, &ns, &ops, &gbs, &spread) < 8)
+			continue;
+
+		for (i = 0; i < records.size(); i++) {
+			if (records[i].name != name || records[i].d != d || records[i].l != l
+					|| records[i].batch != batch || records[i].threads != threads)
+				continue;
+
+			matched++;
+			change = (records[i].ns_per_op - ns) / ns * 100.0;
+			tol = std::max(tolerance, records[i].spread + spread);
+			if (change > tol) {
+				regressions++;
+				printf("REGRESSION %-16s d=%-2d l=%-2d batch=%-6d threads=%-3d %12.1f -> %12.1f ns/op (%+.1f%%)\n",
+					name, d, l, batch, threads, ns, records[i].ns_per_op, change);
+			} else if (change < -tol) {
+				printf("improved   %-16s d=%-2d l=%-2d batch=%-6d threads=%-3d %12.1f -> %12.1f ns/op (%+.1f%%)\n",
+					name, d, l, batch, threads, ns, records[i].ns_per_op, change);
+			}
+		}
+	}
+	fclose(f);
+
+	printf("%d records compared, %d regressions\n", matched, regressions);
+
+	return regressions;
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<int> dims, levels, batches, threads;
+	const char *out = NULL, *baseline = NULL;
+	double tolerance = 10.0;
+	int npoints = 4096;
+	int i, j, hw;
+
+	hw = std::thread::hardware_concurrency();
+	if (hw < 1)
+		hw = 1;
+
+	dims.push_back(2); dims.push_back(4); dims.push_back(6);
+	levels.push_back(4); levels.push_back(6);
+	batches.push_back(1); batches.push_back(64); batches.push_back(1024);
+	threads.push_back(1);
+	if (hw > 1)
+		threads.push_back(hw);
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-q")) {
+			dims.assign(1, 3);
+			levels.assign(1, 4);
+			npoints = 512;
+		} else if (!strcmp(argv[i], "-z")) {
+			grid_type = GRID_ZERO_BOUNDARY;
+		} else if (!strcmp(argv[i], "-x")) {
+			grid_type = GRID_MODIFIED;
+		} else if (!strcmp(argv[i], "-n")) {
+			numa = 1;
+		} else if (!strcmp(argv[i], "-m")) {
+			morton = 1;
+		} else if (i + 1 < argc) {
+			if (!strcmp(argv[i], "-d"))
+				dims = parse_list(argv[++i]);
+			else if (!strcmp(argv[i], "-l"))
+				levels = parse_list(argv[++i]);
+			else if (!strcmp(argv[i], "-b"))
+				batches = parse_list(argv[++i]);
+			else if (!strcmp(argv[i], "-t"))
+				threads = parse_list(argv[++i]);
+			else if (!strcmp(argv[i], "-p"))
+				npoints = atoi(argv[++i]);
+			else if (!strcmp(argv[i], "-o"))
+				out = argv[++i];
+			else if (!strcmp(argv[i], "-c"))
+				baseline = argv[++i];
+			else if (!strcmp(argv[i], "-r"))
+				tolerance = atof(argv[++i]);
+			else if (!strcmp(argv[i], "-k")) {
+				repeats = atoi(argv[++i]);
+				if (repeats < 1)
+					goto usage;
+			}
+			else if (!strcmp(argv[i], "-a")) {
+				for (j = ALLOC_DEFAULT; j < ALLOC_CUSTOM; j++)
+					if (!strcmp(argv[i + 1], Allocator::name((AllocKind) j)))
+						break;
+				if (j == ALLOC_CUSTOM)
+					goto usage;
+				allocator = new Allocator((AllocKind) j);
+				i++;
+			} else if (!strcmp(argv[i], "-i")) {
+				for (j = ISA_SCALAR; j < ISA_NUM_LEVELS; j++)
+					if (!strcmp(argv[i + 1], Kernels::name((IsaLevel) j)))
+						break;
+				if (j == ISA_NUM_LEVELS)
+					goto usage;
+				if (Kernels::select((IsaLevel) j))
+					printf("%s kernels not supported by this CPU\n", argv[i + 1]);
+				i++;
+			}
+			else
+				goto usage;
+		} else {
+			goto usage;
+		}
+	}
+
+	printf("kernels: %s\n", Kernels::name(Kernels::level()));
+	for (i = 0; i < (int) dims.size(); i++)
+		for (j = 0; j < (int) levels.size(); j++)
+			bench_grid(dims[i], levels[j], batches, threads, npoints);
+
+	if (out && write_json(out))
+		return 2;
+
+	if (baseline && compare_baseline(baseline, tolerance))
+		return 1;
+
+	return 0;
+
+	usage:
+	std::cout << "Usage: " << argv[0] << " [-d 2,4,6] [-l 4,6] [-b 1,64,1024] [-t 1,2,4] [-p points]"
+		<< " [-o out.json] [-c baseline.json] [-r tolerance_percent] [-k repeats] [-q] [-z] [-x] [-n] [-m]"
+		<< " [-a default|aligned|huge_transparent|huge_2mb|huge_1gb] [-i scalar|sse4.2|avx2|avx512]" << std::endl;
+
+	return 2;
+}
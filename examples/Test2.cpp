@@ -25,16 +25,31 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
 
 #include <iostream>
+#include <string>
 #include <vector>
 #include <set>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 #include "SparseGrid.h"
 #include "Converter.h"
 #include "Helper.h"
+#include "Kernels.h"
+#include "HierarchizationPlan.h"
+#include "SharedSparseGrid.h"
+#include "OutOfCoreSparseGrid.h"
+#include "VersionedSparseGrid.h"
+#include "TaskPool.h"
+#include "EvaluationService.h"
+#include "Instrumentation.h"
 
 using namespace std;
 
@@ -62,6 +77,50 @@ class SampleFct : public Function
 		}
 };
 
+class ZeroBoundaryFct : public Function
+{
+	private:
+		int d;
+
+	public:
+		ZeroBoundaryFct(int d) { this->d = d; }
+	
+		int getD() { return d; }
+	
+		float getValue(float *coords)
+		{
+			int i;
+			float prod = 1;
+
+			for (i = 0; i < d; i++)
+				prod *= 4 * coords[i] * (1 - coords[i]) * (2 - coords[i]);
+
+			return prod;
+		}
+};
+
+/* allocator provided by the caller; counts the memory it hands out */
+class CountingAllocator : public Allocator
+{
+	public:
+		long live;
+
+		CountingAllocator() { live = 0; }
+
+		void *allocate(size_t size, AllocKind *backing)
+		{
+			live += size;
+			*backing = ALLOC_CUSTOM;
+			return malloc(size);
+		}
+
+		void release(void *p, size_t size, AllocKind)
+		{
+			live -= size;
+			free(p);
+		}
+};
+
 std::vector<int> visited;
 int generate_points(int const_d, int const_l, float* gp, int crt_d,  int n, int numGridPoints)
 {
@@ -225,6 +284,1515 @@ int testBijection(int d, int l)
 	}
 }
 
+/*
+ * test if the bulk conversions agree with the point-wise ones
+ */
+int testBulkConversions(int d, int l)
+{
+	int b = 0, i, j;
+	int nrGridPoints = SparseGrid::size(d, l);
+	int *idx = (int *) malloc(nrGridPoints * sizeof(int));
+	int *idx2 = (int *) malloc(nrGridPoints * sizeof(int));
+	int *lev = (int *) malloc(nrGridPoints * d * sizeof(int));
+	int *ind = (int *) malloc(nrGridPoints * d * sizeof(int));
+	float *coords = (float *) malloc(nrGridPoints * d * sizeof(float));
+	int slev[d], sind[d];
+	float scoords[d];
+
+	for (i = 0; i < nrGridPoints; i++)
+		idx[i] = i;
+
+	Converter::bulk_idx2gp(idx, nrGridPoints, lev, ind, d, l);
+	Converter::bulk_li2coord(lev, ind, nrGridPoints, coords, d);
+
+	for (i = 0; i < nrGridPoints && !b; i++) {
+		Converter::idx2gp(i, slev, sind, d, l);
+		Converter::li2coord(slev, sind, scoords, d);
+		for (j = 0; j < d; j++)
+			if (slev[j] != lev[i * d + j] || sind[j] != ind[i * d + j] || scoords[j] != coords[i * d + j])
+				b = 1;
+	}
+
+	/* coords -> (l, i) -> index must give back the identity */
+	Converter::bulk_coord2li(coords, nrGridPoints, lev, ind, d);
+	Converter::bulk_gp2idx(lev, ind, nrGridPoints, idx2, d, l);
+	for (i = 0; i < nrGridPoints && !b; i++)
+		if (idx2[i] != i)
+			b = 1;
+
+	free(idx);
+	free(idx2);
+	free(lev);
+	free(ind);
+	free(coords);
+
+	if (!b) {
+		cout << "Bulk conversion test ..................... [passed]" << endl;
+		return 0;
+	} else {
+		cout << "Bulk conversion test ..................... [failed]" << endl;
+		return 1;
+	}
+}
+
+/*
+ * test that a 0-boundary grid interpolates like the non-0 boundary grid for a function that is 0 on the boundary
+ */
+int testZeroBoundary(int d, int l)
+{
+	int b = 0, i, j;
+	ZeroBoundaryFct fct(d);
+	SparseGrid zsg(l, &fct, GRID_ZERO_BOUNDARY);
+	SparseGrid sg(l, &fct);
+	int bs = 64;
+	float coords[bs][d], vals[bs], zvals[bs];
+
+	zsg.hierarchize();
+	sg.hierarchize();
+
+	if (zsg.size() != Helper::zerob_size(d, l))
+		b = 1;
+
+	/* interpolation property at the interior grid points */
+	for (i = 0; i < zsg.size() && !b; i++) {
+		Converter::zb_idx2gp(i, coords[0], d);
+		if (fabs(zsg.evaluate(coords[0]) - fct.getValue(coords[0])) > 0.001 * fabs(fct.getValue(coords[0])))
+			b = 1;
+	}
+
+	srand(d * 100 + l);
+	for (i = 0; i < bs; i++)
+		for (j = 0; j < d; j++)
+			coords[i][j] = (float) rand() / RAND_MAX;
+
+	zsg.evaluate((float *) coords, bs, zvals);
+	sg.evaluate((float *) coords, bs, vals);
+	for (i = 0; i < bs && !b; i++)
+		if (fabs(zvals[i] - vals[i]) > 0.0001 || fabs(zsg.evaluate(coords[i]) - vals[i]) > 0.0001)
+			b = 1;
+
+	if (!b) {
+		cout << "Zero boundary test ....................... [passed]" << endl;
+		return 0;
+	} else {
+		cout << "Zero boundary test ....................... [failed]" << endl;
+		return 1;
+	}
+}
+
+/*
+ * test that the out-of-core grid (with a budget far smaller than the grid) gives the same results as the in-core one
+ */
+int testOutOfCore(int d, int l)
+{
+	int b = 0, i, j, t;
+	SampleFct fct(d);
+	int bs = 64;
+	float coords[bs][d], vals[bs], ovals[bs];
+	char path[] = "/tmp/fsg_ooc_XXXXXX";
+	GridType types[2] = { GRID_BOUNDARY, GRID_ZERO_BOUNDARY };
+
+	i = mkstemp(path);
+	if (i < 0) {
+		cout << "Out-of-core test ......................... [failed]" << endl;
+		return 1;
+	}
+	close(i);
+
+	srand(d * 100 + l);
+	for (i = 0; i < bs; i++)
+		for (j = 0; j < d; j++)
+			coords[i][j] = (float) rand() / RAND_MAX;
+
+	for (t = 0; t < 2 && !b; t++) {
+		SparseGrid sg(l, &fct, types[t]);
+		sg.hierarchize();
+		{
+			OutOfCoreSparseGrid osg(l, &fct, path, 4096, types[t]);
+			if (osg.size() != sg.size() || osg.hierarchize())
+				b = 1;
+		}
+
+		/* reopen the file written above */
+		OutOfCoreSparseGrid osg(d, l, path, 4096, types[t]);
+		sg.evaluate((float *) coords, bs, vals);
+		if (osg.evaluate((float *) coords, bs, ovals))
+			b = 1;
+		for (i = 0; i < bs && !b; i++)
+			if (fabs(ovals[i] - vals[i]) > 0.0001 * fabs(vals[i]) + 0.00001
+					|| fabs(osg.evaluate(coords[i]) - vals[i]) > 0.0001 * fabs(vals[i]) + 0.00001)
+				b = 1;
+	}
+
+	/* a sparse file of more than 2^31 floats: the positions beyond that must not wrap around (run once) */
+	if (d == 1 && l == 1 && !b) {
+		int64_t big = 2513043457LL, at = big - 5;
+		float marks[4] = { 1.0f, 2.0f, 3.0f, 4.0f }, back[4];
+
+		i = open(path, O_RDWR);
+		if (i >= 0 && ftruncate(i, (off_t) big * sizeof(float)) == 0) {
+			if (pwrite(i, marks, sizeof(marks), (off_t) at * sizeof(float)) != sizeof(marks))
+				b = 1;
+			close(i);
+			OutOfCoreSparseGrid osg(5, 17, path, 4096);
+			if (osg.size() != big || osg.read(at, 4, back) || memcmp(back, marks, sizeof(marks))
+					|| osg.read(big - 3, 4, back) == 0)
+				b = 1;
+		} else if (i >= 0) {
+			close(i);
+		}
+
+		/* a grid too large for a file is rejected instead of wrapping around */
+		OutOfCoreSparseGrid huge(60, 40, path, 4096);
+		if (huge.size() != 0 || huge.hierarchize() != -1)
+			b = 1;
+
+		/* a file that cannot be created, or written (/dev/full), leaves an empty grid */
+		OutOfCoreSparseGrid missing(l, &fct, "/nonexistent/fsg_ooc", 4096);
+		if (missing.size() != 0 || missing.hierarchize() != -1)
+			b = 1;
+		if (access("/dev/full", W_OK) == 0) {
+			OutOfCoreSparseGrid full(l, &fct, "/dev/full", 4096);
+			if (full.size() != 0 || full.hierarchize() != -1)
+				b = 1;
+		}
+	}
+	unlink(path);
+
+	if (!b) {
+		cout << "Out-of-core test ......................... [passed]" << endl;
+		return 0;
+	} else {
+		cout << "Out-of-core test ......................... [failed]" << endl;
+		return 1;
+	}
+}
+
+/*
+ * test that the multi-threaded evaluation gives the same results as the single-threaded one under every NUMA policy
+ */
+int testNuma(int d, int l)
+{
+	int b = 0, i, j, p;
+	SampleFct fct(d);
+	SparseGrid sg(l, &fct);
+	int bs = 64;
+	float coords[bs][d], vals[bs], tvals[bs];
+	NumaPolicy policies[4] = { NUMA_NONE, NUMA_INTERLEAVE, NUMA_REPLICATE, NUMA_PARTITION };
+
+	srand(d * 100 + l);
+	for (i = 0; i < bs; i++)
+		for (j = 0; j < d; j++)
+			coords[i][j] = (float) rand() / RAND_MAX;
+
+	/* the replicas are made before hierarchize, which has to refresh them */
+	sg.setNumaPolicy(NUMA_REPLICATE, 3);
+	sg.hierarchize();
+	sg.evaluate((float *) coords, bs, vals);
+
+	for (p = 0; p < 4 && !b; p++) {
+		/* the placement itself may be refused (e.g. in containers), the results must not change */
+		sg.setNumaPolicy(policies[p], 3);
+		if (sg.getNumaPolicy() != policies[p] || sg.evaluate((float *) coords, bs, tvals, 3))
+			b = 1;
+		for (i = 0; i < bs && !b; i++)
+			if (fabs(tvals[i] - vals[i]) > 0.0001 * fabs(vals[i]) + 0.00001)
+				b = 1;
+	}
+
+	if (!b) {
+		cout << "NUMA placement test ...................... [passed]" << endl;
+		return 0;
+	} else {
+		cout << "NUMA placement test ...................... [failed]" << endl;
+		return 1;
+	}
+}
+
+/*
+ * test that every allocation policy gives the same results and reports a sensible backing
+ */
+int testAllocators(int d, int l)
+{
+	int b = 0, i, j, k;
+	SampleFct fct(d);
+	SparseGrid sg(l, &fct);
+	int bs = 64;
+	float coords[bs][d], vals[bs], avals[bs];
+	AllocKind kinds[5] = { ALLOC_DEFAULT, ALLOC_ALIGNED, ALLOC_HUGE_TRANSPARENT, ALLOC_HUGE_2MB, ALLOC_HUGE_1GB };
+	CountingAllocator counting;
+
+	srand(d * 100 + l);
+	for (i = 0; i < bs; i++)
+		for (j = 0; j < d; j++)
+			coords[i][j] = (float) rand() / RAND_MAX;
+	sg.hierarchize();
+	sg.evaluate((float *) coords, bs, vals);
+
+	for (k = 0; k < 5 && !b; k++) {
+		Allocator allocator(kinds[k]);
+		SparseGrid asg(l, &fct, GRID_BOUNDARY, &allocator);
+
+		/* a request may fall back to a weaker kind, never to a stronger one */
+		if (asg.getBacking() > kinds[k] || (kinds[k] != ALLOC_DEFAULT && asg.getBacking() == ALLOC_DEFAULT))
+			b = 1;
+		asg.hierarchize();
+		asg.evaluate((float *) coords, bs, avals);
+		for (i = 0; i < bs && !b; i++)
+			if (avals[i] != vals[i])
+				b = 1;
+	}
+
+	{
+		SparseGrid csg(l, &fct, GRID_BOUNDARY, &counting);
+		if (csg.getBacking() != ALLOC_CUSTOM || counting.live != (long) (csg.size() * sizeof(float)))
+			b = 1;
+	}
+	if (counting.live != 0)
+		b = 1;
+
+	if (!b) {
+		cout << "Allocator test ........................... [passed]" << endl;
+		return 0;
+	} else {
+		cout << "Allocator test ........................... [failed]" << endl;
+		return 1;
+	}
+}
+
+/*
+ * test that readers always see a complete version while a writer keeps publishing new ones
+ */
+int testVersioned(int d, int l)
+{
+	int b = 0, i, t, k;
+	SampleFct fct(d);
+	ZeroBoundaryFct zfct(d);
+	Function *fcts[2] = { &fct, &zfct };
+	float coords[d], expected[2];
+	std::atomic<int> stop(0), mismatches(0);
+	std::vector<std::thread> readers;
+
+	for (i = 0; i < d; i++)
+		coords[i] = 0.3f + 0.1f * i / d;
+	for (k = 0; k < 2; k++) {
+		SparseGrid sg(l, fcts[k]);
+		sg.hierarchize();
+		expected[k] = sg.evaluate(coords);
+	}
+
+	SparseGrid *first = new SparseGrid(l, fcts[0]);
+	first->hierarchize();
+	VersionedSparseGrid vsg(first);
+
+	for (t = 0; t < 4; t++)
+		readers.push_back(std::thread([&]() {
+			float val;
+			const SparseGrid *pinned;
+
+			while (!stop.load()) {
+				val = vsg.evaluate(coords);
+				if (val != expected[0] && val != expected[1])
+					mismatches++;
+
+				/* two queries against one pinned version */
+				pinned = vsg.acquire();
+				val = pinned->evaluate(coords);
+				if (pinned->evaluate(coords) != val)
+					mismatches++;
+				vsg.release();
+			}
+		}));
+
+	for (k = 1; k <= 20; k++) {
+		SparseGrid *next = new SparseGrid(l, fcts[k % 2]);
+		next->hierarchize();
+		if (vsg.publish(next) != k + 1)
+			b = 1;
+	}
+	stop.store(1);
+	for (t = 0; t < 4; t++)
+		readers[t].join();
+
+	vsg.synchronize();
+	if (mismatches.load() != 0 || vsg.reclaim() != 0 || vsg.evaluate(coords) != expected[0])
+		b = 1;
+
+	if (!b) {
+		cout << "Versioned grid test ...................... [passed]" << endl;
+		return 0;
+	} else {
+		cout << "Versioned grid test ...................... [failed]" << endl;
+		return 1;
+	}
+}
+
+/* completion of a callback query of testService */
+static void service_done(float val, void *arg)
+{
+	*(float *) arg = val;
+}
+
+/*
+ * test that the evaluation service returns the same values as the batch evaluation, through futures and callbacks
+ */
+int testService(int d, int l)
+{
+	int b = 0, i, j, t, n = 200;
+	SampleFct fct(d);
+	SparseGrid sg(l, &fct);
+	std::vector<float> coords(4 * n * d), vals(4 * n), got(4 * n, -1.0f);
+	std::vector<std::thread> submitters;
+	std::atomic<int> mismatches(0);
+	long queries, batches;
+
+	sg.hierarchize();
+	srand(d * 100 + l);
+	for (i = 0; i < 4 * n * d; i++)
+		coords[i] = (float) rand() / RAND_MAX;
+	sg.evaluate(&coords[0], 4 * n, &vals[0]);
+
+	{
+		EvaluationService service(&sg, 2, 32, 200);
+
+		/* two threads wait on futures, two use callbacks */
+		for (t = 0; t < 4; t++)
+			submitters.push_back(std::thread([&, t]() {
+				std::vector<std::future<float> > futures;
+				int k;
+
+				for (k = t * n; k < (t + 1) * n; k++) {
+					if (t < 2)
+						futures.push_back(service.submit(&coords[k * d]));
+					else
+						while (service.submit(&coords[k * d], service_done, &got[k]))
+							std::this_thread::yield();
+				}
+				for (k = 0; k < (int) futures.size(); k++)
+					if (futures[k].get() != vals[t * n + k])
+						mismatches++;
+			}));
+		for (t = 0; t < 4; t++)
+			submitters[t].join();
+	}
+
+	/* the destructor has completed all the callbacks */
+	for (j = 2 * n; j < 4 * n; j++)
+		if (got[j] != vals[j])
+			b = 1;
+
+	EvaluationService service(&sg, 1, 8, 50);
+	service.submit(&coords[0]).get();
+	service.getStats(&queries, &batches);
+	if (mismatches.load() != 0 || queries != 1 || batches != 1)
+		b = 1;
+
+	if (!b) {
+		cout << "Evaluation service test .................. [passed]" << endl;
+		return 0;
+	} else {
+		cout << "Evaluation service test .................. [failed]" << endl;
+		return 1;
+	}
+}
+
+/* SampleFct with different values at some grid points */
+class PatchedFct : public Function
+{
+	private:
+		int d, l;
+		GridType type;
+		std::set<int> changed;
+
+	public:
+		PatchedFct(int d, int l, GridType type, std::set<int> &changed)
+		{
+			this->d = d;
+			this->l = l;
+			this->type = type;
+			this->changed = changed;
+		}
+
+		int getD() { return d; }
+
+		float getValue(float *coords)
+		{
+			SampleFct fct(d);
+			int levels[d], indices[d], index;
+
+			Converter::coord2li(coords, levels, indices, d);
+			if (type != GRID_BOUNDARY)
+				index = Converter::zb_gp2idx(levels, indices, d);
+			else
+				index = Converter::gp2idx(levels, indices, d, l);
+
+			return changed.count(index) ? 2 * fct.getValue(coords) + 1 : fct.getValue(coords);
+		}
+};
+
+/*
+ * test that updating some nodal values gives the same coefficients as hierarchizing the changed grid again
+ */
+int testUpdate(int d, int l)
+{
+	int b = 0, i, j, k;
+	SampleFct fct(d);
+	GridType types[3] = { GRID_BOUNDARY, GRID_ZERO_BOUNDARY, GRID_MODIFIED };
+	float coords[d], expected, val;
+
+	for (k = 0; k < 3; k++) {
+		SparseGrid sg(l, &fct, types[k]);
+		std::set<int> changed;
+		std::vector<int> positions;
+		std::vector<float> values;
+
+		/* a few points, among them the first and the last one */
+		srand(d * 100 + l);
+		changed.insert(0);
+		changed.insert(sg.size() - 1);
+		for (i = 0; i < 3; i++)
+			changed.insert(rand() % sg.size());
+
+		PatchedFct pfct(d, l, types[k], changed);
+		SparseGrid ref(l, &pfct, types[k]);
+		for (std::set<int>::iterator it = changed.begin(); it != changed.end(); ++it) {
+			if (types[k] != GRID_BOUNDARY)
+				Converter::zb_idx2gp(*it, coords, d);
+			else
+				Converter::idx2gp(*it, coords, d, l);
+			positions.push_back(*it);
+			values.push_back(pfct.getValue(coords));
+		}
+
+		sg.hierarchize();
+		ref.hierarchize();
+		if (sg.update(&positions[0], &values[0], positions.size()))
+			b = 1;
+
+		/* the grid points and some random points */
+		for (i = 0; i < sg.size() + 50; i++) {
+			if (i >= sg.size())
+				for (j = 0; j < d; j++)
+					coords[j] = (float) rand() / RAND_MAX;
+			else if (types[k] != GRID_BOUNDARY)
+				Converter::zb_idx2gp(i, coords, d);
+			else
+				Converter::idx2gp(i, coords, d, l);
+			expected = ref.evaluate(coords);
+			val = sg.evaluate(coords);
+			if (fabs(val - expected) > 0.0001 * fabs(expected) + 0.0001)
+				b = 1;
+		}
+
+		/* many small updates against a fresh hierarchization of the same nodal values */
+		std::vector<float> nodal(sg.size());
+		for (i = 0; i < sg.size(); i++) {
+			if (types[k] != GRID_BOUNDARY)
+				Converter::zb_idx2gp(i, coords, d);
+			else
+				Converter::idx2gp(i, coords, d, l);
+			nodal[i] = pfct.getValue(coords);
+		}
+		for (i = 0; i < 200; i++) {
+			int pos[2];
+			float vals[2];
+
+			for (j = 0; j < 2; j++) {
+				pos[j] = rand() % sg.size();
+				vals[j] = (float) rand() / RAND_MAX;
+			}
+			if (pos[1] == pos[0])
+				vals[1] = vals[0];
+			for (j = 0; j < 2; j++)
+				nodal[pos[j]] = vals[j];
+			if (sg.update(pos, vals, 2))
+				b = 1;
+		}
+
+		/* a grid that still holds nodal values gets the new value as it is */
+		std::vector<float> stale(nodal);
+		int last = sg.size() - 1;
+		stale[last] += 1.0f;
+		SparseGrid fresh(d, l, &stale[0], types[k]);
+		if (fresh.update(&last, &nodal[last], 1))
+			b = 1;
+		fresh.hierarchize();
+
+		/* both sides are hierarchized in float: the rounding follows the largest value of the grid */
+		float scale = 0.0f;
+		for (i = 0; i < sg.size(); i++)
+			scale = std::max(scale, fabsf(nodal[i]));
+		for (i = 0; i < sg.size(); i++) {
+			if (types[k] != GRID_BOUNDARY)
+				Converter::zb_idx2gp(i, coords, d);
+			else
+				Converter::idx2gp(i, coords, d, l);
+			expected = fresh.evaluate(coords);
+			val = sg.evaluate(coords);
+			if (fabs(val - expected) > 0.00001 * scale + 0.0001 || fabs(expected - nodal[i]) > 0.00001 * scale + 0.0001)
+				b = 1;
+		}
+	}
+
+	if (!b) {
+		cout << "Incremental update test .................. [passed]" << endl;
+		return 0;
+	} else {
+		cout << "Incremental update test .................. [failed]" << endl;
+		return 1;
+	}
+}
+
+/*
+ * test that the level-truncated evaluation stays within the bound it returns
+ */
+int testTruncated(int d, int l)
+{
+	int b = 0, i, j, k, m, n = 64;
+	SampleFct fct(d);
+	ZeroBoundaryFct zfct(d);
+	GridType types[3] = { GRID_BOUNDARY, GRID_ZERO_BOUNDARY, GRID_MODIFIED };
+	Function *fcts[3] = { &fct, &zfct, &fct };
+	float coords[n * d], full[n], vals[n], bound, val, tol;
+
+	srand(d * 100 + l);
+	for (i = 0; i < n * d; i++)
+		coords[i] = (float) rand() / RAND_MAX;
+
+	for (k = 0; k < 3; k++) {
+		SparseGrid sg(l, fcts[k], types[k]);
+		sg.hierarchize();
+		sg.evaluate(coords, n, full);
+
+		for (m = 0; m <= l; m++) {
+			if (sg.evaluate(coords, n, vals, m, -1, &bound))
+				b = 1;
+			/* all levels: exact */
+			if (m == l && bound != 0.0f)
+				b = 1;
+			for (j = 0; j < n; j++) {
+				if (fabs(vals[j] - full[j]) > bound + 0.0001 * fabs(full[j]) + 0.0001)
+					b = 1;
+				val = sg.evaluate(coords + j * d, m, -1, NULL);
+				if (fabs(val - vals[j]) > 0.0001 * fabs(vals[j]) + 0.0001)
+					b = 1;
+			}
+		}
+
+		/* a tolerance cuts off only levels whose bound is within it */
+		tol = 0.05f * fabs(full[0]) + 0.01f;
+		val = sg.evaluate(coords, l, tol, &bound);
+		if (bound > tol || fabs(val - full[0]) > bound + 0.0001 * fabs(full[0]) + 0.0001)
+			b = 1;
+	}
+
+	if (!b) {
+		cout << "Truncated evaluation test ................ [passed]" << endl;
+		return 0;
+	} else {
+		cout << "Truncated evaluation test ................ [failed]" << endl;
+		return 1;
+	}
+}
+
+/*
+ * test that the Morton reordering of a batch is a permutation and does not change the results
+ */
+int testReordering(int d, int l)
+{
+	int b = 0, i, j, n = 300;
+	SampleFct fct(d);
+	SparseGrid sg(l, &fct);
+	std::vector<float> coords(n * d + 1), vals(n), rvals(n);
+	std::vector<int> order(n);
+	std::set<int> seen;
+
+	srand(d * 100 + l);
+	for (i = 0; i < n * d; i++)
+		coords[i] = (float) rand() / RAND_MAX;
+
+	Helper::morton_order(&coords[0], n, d, &order[0]);
+	for (j = 0; j < n; j++)
+		seen.insert(order[j]);
+	if ((int) seen.size() != n || *seen.begin() != 0 || *seen.rbegin() != n - 1)
+		b = 1;
+
+	sg.hierarchize();
+	sg.evaluate(&coords[0], n, &vals[0]);
+	sg.setReordering(2);
+	sg.evaluate(&coords[0], n, &rvals[0]);
+	for (j = 0; j < n; j++)
+		if (rvals[j] != vals[j])
+			b = 1;
+
+	if (!b) {
+		cout << "Reordered evaluation test ................ [passed]" << endl;
+		return 0;
+	} else {
+		cout << "Reordered evaluation test ................ [failed]" << endl;
+		return 1;
+	}
+}
+
+class LinearFct : public Function
+{
+	private:
+		int d;
+
+	public:
+		LinearFct(int d) { this->d = d; }
+
+		int getD() { return d; }
+
+		float getValue(float *coords)
+		{
+			int i;
+			float sum = 1;
+
+			for (i = 0; i < d; i++)
+				sum += (i + 1) * coords[i] / d;
+
+			return sum;
+		}
+};
+
+/*
+ * test the modified linear basis: interpolation at the interior points, exact linear functions up to the
+ * boundary, and the same results from the single point, batch and multi-threaded evaluations
+ */
+int testModified(int d, int l)
+{
+	int b = 0, i, j, n = 64;
+	SampleFct fct(d);
+	LinearFct lfct(d);
+	SparseGrid sg(l, &fct, GRID_MODIFIED);
+	SparseGrid lsg(l, &lfct, GRID_MODIFIED);
+	float coords[n * d], vals[n], tvals[n], val;
+
+	if (sg.size() != Helper::zerob_size(d, l))
+		b = 1;
+
+	sg.hierarchize();
+	lsg.hierarchize();
+
+	for (i = 0; i < sg.size(); i++) {
+		Converter::zb_idx2gp(i, coords, d);
+		if (fabs(sg.evaluate(coords) - fct.getValue(coords)) > 0.0001 * fabs(fct.getValue(coords)))
+			b = 1;
+	}
+
+	/* random points, the first two on the corners */
+	srand(d * 100 + l);
+	for (i = 0; i < n * d; i++)
+		coords[i] = i < 2 * d ? i / d : (float) rand() / RAND_MAX;
+
+	/* a linear function needs levels 0 and 1 in one dimension at a time */
+	if (l >= 2)
+		for (j = 0; j < n; j++) {
+			val = lsg.evaluate(coords + j * d);
+			if (fabs(val - lfct.getValue(coords + j * d)) > 0.0001 * fabs(lfct.getValue(coords + j * d)))
+				b = 1;
+		}
+
+	sg.evaluate(coords, n, vals);
+	sg.evaluate(coords, n, tvals, 2);
+	for (j = 0; j < n; j++) {
+		val = sg.evaluate(coords + j * d);
+		if (fabs(vals[j] - val) > 0.0001 * fabs(val) || fabs(tvals[j] - val) > 0.0001 * fabs(val))
+			b = 1;
+	}
+
+	if (!b) {
+		cout << "Modified basis test ...................... [passed]" << endl;
+		return 0;
+	} else {
+		cout << "Modified basis test ...................... [failed]" << endl;
+		return 1;
+	}
+}
+
+/* SampleFct that counts its calls */
+class CountingFct : public Function
+{
+	private:
+		int d;
+
+	public:
+		std::atomic<int> calls;
+
+		CountingFct(int d) { this->d = d; calls = 0; }
+
+		int getD() { return d; }
+
+		float getValue(float *coords)
+		{
+			SampleFct fct(d);
+
+			calls++;
+			return fct.getValue(coords);
+		}
+};
+
+/*
+ * test that growing a grid by one level samples only the new points and gives the grid built at that level
+ */
+int testRefineLevel(int d, int l)
+{
+	int b = 0, i, j, k, n = 64;
+	GridType types[3] = { GRID_BOUNDARY, GRID_ZERO_BOUNDARY, GRID_MODIFIED };
+	float coords[n * d], expected, val;
+
+	srand(d * 100 + l);
+	for (i = 0; i < n * d; i++)
+		coords[i] = (float) rand() / RAND_MAX;
+
+	for (k = 0; k < 3; k++) {
+		CountingFct fct(d);
+		SparseGrid sg(l, &fct, types[k]);
+		SparseGrid ref(l + 1, &fct, types[k]);
+		int before = sg.size();
+
+		fct.calls = 0;
+		sg.hierarchize();
+		ref.hierarchize();
+		if (sg.refineLevel(&fct, 3) || sg.getL() != l + 1 || sg.size() != ref.size()
+				|| fct.calls.load() != ref.size() - before)
+			b = 1;
+
+		for (j = 0; j < n; j++) {
+			expected = ref.evaluate(coords + j * d);
+			val = sg.evaluate(coords + j * d);
+			if (fabs(val - expected) > 0.0001 * fabs(expected) + 0.0001)
+				b = 1;
+		}
+
+		/* a grid holding function values stays that way */
+		SparseGrid nodal(l, &fct, types[k]);
+		nodal.refineLevel(&fct);
+		nodal.hierarchize();
+		if (fabs(nodal.evaluate(coords) - ref.evaluate(coords)) > 0.0001 * fabs(ref.evaluate(coords)) + 0.0001)
+			b = 1;
+
+		/* the buffer of a wrapped grid keeps the coefficients it had */
+		std::vector<float> values(before), gp(before * d);
+		SparseGrid::coordinates(d, l, types[k], &gp[0]);
+		for (i = 0; i < before; i++)
+			values[i] = fct.getValue(&gp[i * d]);
+		SparseGrid wrapped(d, l, &values[0], types[k], BUFFER_WRAP);
+		wrapped.hierarchize();
+		std::vector<float> coefficients(values);
+		if (wrapped.refineLevel(&fct) || values != coefficients)
+			b = 1;
+		if (fabs(wrapped.evaluate(coords) - ref.evaluate(coords)) > 0.0001 * fabs(ref.evaluate(coords)) + 0.0001)
+			b = 1;
+	}
+
+	if (!b) {
+		cout << "Refine level test ........................ [passed]" << endl;
+		return 0;
+	} else {
+		cout << "Refine level test ........................ [failed]" << endl;
+		return 1;
+	}
+}
+
+/*
+ * test that coarsening a hierarchized grid gives the grid built at the lower level
+ */
+int testCoarsen(int d, int l)
+{
+	int b = 0, i, j, k, m, n = 32;
+	SampleFct fct(d);
+	GridType types[3] = { GRID_BOUNDARY, GRID_ZERO_BOUNDARY, GRID_MODIFIED };
+	float coords[n * d], expected, val;
+
+	srand(d * 100 + l);
+	for (i = 0; i < n * d; i++)
+		coords[i] = (float) rand() / RAND_MAX;
+
+	for (k = 0; k < 3; k++) {
+		SparseGrid sg(l, &fct, types[k]);
+
+		if (sg.coarsen(l) != NULL)
+			b = 1;
+		sg.hierarchize();
+
+		for (m = 0; m <= l; m++) {
+			SparseGrid ref(m, &fct, types[k]);
+			SparseGrid *coarse = sg.coarsen(m);
+
+			ref.hierarchize();
+			if (coarse == NULL || coarse->size() != ref.size() || coarse->getL() != m) {
+				b = 1;
+				delete coarse;
+				continue;
+			}
+			for (j = 0; j < n; j++) {
+				expected = ref.evaluate(coords + j * d);
+				val = coarse->evaluate(coords + j * d);
+				if (fabs(val - expected) > 0.0001 * fabs(expected) + 0.0001)
+					b = 1;
+			}
+			delete coarse;
+		}
+	}
+
+	if (!b) {
+		cout << "Coarsen test ............................. [passed]" << endl;
+		return 0;
+	} else {
+		cout << "Coarsen test ............................. [failed]" << endl;
+		return 1;
+	}
+}
+
+/*
+ * test the marginals against a quadrature of the interpolant; the midpoint rule on cells of width 2^-l
+ * is exact for it, as it is linear on these cells in every dimension
+ */
+int testMarginalize(int d, int l)
+{
+	int b = 0, i, j, k, c, q, t, cells = 1 << l, n = 4;
+	SampleFct fct(d);
+	GridType types[3] = { GRID_BOUNDARY, GRID_ZERO_BOUNDARY, GRID_MODIFIED };
+	int mask[d], removed[2], nr;
+	float coords[d], mcoords[d];
+	double sum;
+
+	srand(d * 100 + l);
+	for (k = 0; k < 3; k++) {
+		SparseGrid sg(l, &fct, types[k]);
+		sg.hierarchize();
+
+		/* dimension 0, then dimensions 0 and d - 1 */
+		for (t = 0; t < 2 && t < d; t++) {
+			nr = t + 1;
+			removed[0] = 0;
+			removed[1] = d - 1;
+			for (i = 0; i < d; i++)
+				mask[i] = i == 0 || (t == 1 && i == d - 1);
+
+			SparseGrid *marginal = sg.marginalize(mask);
+			if (marginal == NULL || marginal->getD() != d - nr || marginal->getL() != l) {
+				b = 1;
+				delete marginal;
+				continue;
+			}
+
+			for (j = 0; j < n; j++) {
+				for (i = 0, c = 0; i < d; i++) {
+					coords[i] = (float) rand() / RAND_MAX;
+					if (!mask[i])
+						mcoords[c++] = coords[i];
+				}
+				sum = 0;
+				for (q = 0; q < (nr == 1 ? cells : cells * cells); q++) {
+					coords[removed[0]] = (q % cells + 0.5f) / cells;
+					if (nr == 2)
+						coords[removed[1]] = (q / cells + 0.5f) / cells;
+					sum += sg.evaluate(coords);
+				}
+				sum /= nr == 1 ? cells : cells * cells;
+				if (fabs(marginal->evaluate(mcoords) - sum) > 0.0001 * fabs(sum) + 0.0001)
+					b = 1;
+			}
+			delete marginal;
+		}
+	}
+
+	if (!b) {
+		cout << "Marginalization test ..................... [passed]" << endl;
+		return 0;
+	} else {
+		cout << "Marginalization test ..................... [failed]" << endl;
+		return 1;
+	}
+}
+
+/*
+ * test that a slice gives the same values as the full grid with the fixed coordinates
+ */
+int testSlice(int d, int l)
+{
+	int b = 0, i, j, k, c, t, n = 16;
+	SampleFct fct(d);
+	GridType types[3] = { GRID_BOUNDARY, GRID_ZERO_BOUNDARY, GRID_MODIFIED };
+	int mask[d];
+	float coords[d], values[d], scoords[d], expected;
+
+	srand(d * 100 + l);
+	for (k = 0; k < 3; k++) {
+		SparseGrid sg(l, &fct, types[k]);
+		sg.hierarchize();
+
+		/* dimension 0, then dimensions 0 and d - 1; the values include the boundary */
+		for (t = 0; t < 2 && t < d; t++) {
+			for (i = 0; i < d; i++) {
+				mask[i] = i == 0 || (t == 1 && i == d - 1);
+				values[i] = t == 1 && i == 0 ? 1.0f : (float) rand() / RAND_MAX;
+			}
+
+			SparseGrid *slice = sg.slice(mask, values);
+			if (slice == NULL || slice->getD() != d - t - 1) {
+				b = 1;
+				delete slice;
+				continue;
+			}
+
+			for (j = 0; j < n; j++) {
+				for (i = 0, c = 0; i < d; i++) {
+					coords[i] = mask[i] ? values[i] : (float) rand() / RAND_MAX;
+					if (!mask[i])
+						scoords[c++] = coords[i];
+				}
+				expected = sg.evaluate(coords);
+				if (fabs(slice->evaluate(scoords) - expected) > 0.0001 * fabs(expected) + 0.0001)
+					b = 1;
+			}
+			delete slice;
+		}
+	}
+
+	if (!b) {
+		cout << "Slice test ............................... [passed]" << endl;
+		return 0;
+	} else {
+		cout << "Slice test ............................... [failed]" << endl;
+		return 1;
+	}
+}
+
+/*
+ * test that the tensor-product evaluation on a lattice matches the point-wise evaluation
+ */
+int testTensor(int d, int l)
+{
+	int b = 0, i, j, k, m, total;
+	SampleFct fct(d);
+	GridType types[3] = { GRID_BOUNDARY, GRID_ZERO_BOUNDARY, GRID_MODIFIED };
+	int sizes[d];
+	float *axes[d], coords[d];
+
+	/* a few points per axis, the first and the last on the boundary */
+	srand(d * 100 + l);
+	for (i = 0, total = 1; i < d; i++) {
+		sizes[i] = 2 + (i + l) % 3;
+		axes[i] = new float[sizes[i]];
+		for (m = 0; m < sizes[i]; m++)
+			axes[i][m] = m == 0 ? 0.0f : (m == sizes[i] - 1 ? 1.0f : (float) rand() / RAND_MAX);
+		total *= sizes[i];
+	}
+	float *vals = new float[total];
+
+	for (k = 0; k < 3; k++) {
+		SparseGrid sg(l, &fct, types[k]);
+		sg.hierarchize();
+
+		if (sg.evaluateTensor(axes, sizes, vals)) {
+			b = 1;
+			continue;
+		}
+		for (j = 0; j < total; j++) {
+			/* row-major: the last dimension varies fastest */
+			for (i = d - 1, m = j; i >= 0; i--) {
+				coords[i] = axes[i][m % sizes[i]];
+				m /= sizes[i];
+			}
+			if (fabs(vals[j] - sg.evaluate(coords)) > 0.0001 * fabs(vals[j]) + 0.0001)
+				b = 1;
+		}
+	}
+
+	delete[] vals;
+	for (i = 0; i < d; i++)
+		delete[] axes[i];
+
+	if (!b) {
+		cout << "Tensor evaluation test ................... [passed]" << endl;
+		return 0;
+	} else {
+		cout << "Tensor evaluation test ................... [failed]" << endl;
+		return 1;
+	}
+}
+
+/*
+ * test that the kernels of every instruction set level the CPU supports agree with the scalar ones
+ */
+int testKernels(int d, int l)
+{
+	int b = 0, i, j, k, isa, n = 67;
+	SampleFct fct(d);
+	GridType types[3] = { GRID_BOUNDARY, GRID_ZERO_BOUNDARY, GRID_MODIFIED };
+	IsaLevel initial = Kernels::level();
+	std::vector<float> coords(n * d), expected(n), vals(n), back(n * d);
+	std::vector<int> levels(n * d), indices(n * d);
+	float group[15 * n], poles[15 * n], single[15 * n], left[n], right[n];
+	float *blocks[4], *pole[4];
+
+	/* random points, some of them on the boundary */
+	srand(d * 100 + l);
+	for (i = 0; i < n * d; i++)
+		coords[i] = i % 7 == 0 ? (float) (i % 2) : (float) rand() / RAND_MAX;
+	for (i = 0; i < 15 * n; i++)
+		group[i] = (float) rand() / RAND_MAX;
+	for (i = 0; i < n; i++) {
+		left[i] = (float) rand() / RAND_MAX;
+		right[i] = (float) rand() / RAND_MAX;
+	}
+
+	for (k = 0; k < 3; k++) {
+		Kernels::select(ISA_SCALAR);
+		SparseGrid sg(l, &fct, types[k]);
+		sg.hierarchize();
+		sg.evaluate(&coords[0], n, &expected[0]);
+
+		for (isa = ISA_SCALAR; isa < ISA_NUM_LEVELS; isa++) {
+			if (Kernels::select((IsaLevel) isa))
+				continue;
+
+			/* evaluation */
+			sg.evaluate(&coords[0], n, &vals[0]);
+			for (j = 0; j < n; j++)
+				if (fabs(vals[j] - expected[j]) > 0.0001 * fabs(expected[j]) + 0.0001)
+					b = 1;
+
+			/* hierarchization, with and without parents */
+			SparseGrid other(l, &fct, types[k]);
+			other.hierarchize();
+			for (j = 0; j < n; j++)
+				if (fabs(other.evaluate(&coords[j * d]) - expected[j]) > 0.0001 * fabs(expected[j]) + 0.0001)
+					b = 1;
+
+			/* a pole group of the last dimension (levels 0..3, inner 1) against its poles one by one */
+			memcpy(poles, group, sizeof(poles));
+			memcpy(single, group, sizeof(single));
+			for (i = 0; i < 4; i++)
+				blocks[i] = poles + n * ((1 << i) - 1);
+			Kernels::hierarchize_poles(blocks, 3, types[k] == GRID_BOUNDARY ? left : NULL,
+				types[k] == GRID_BOUNDARY ? right : NULL, n, 1, types[k], 0);
+			for (j = 0; j < n; j++) {
+				for (i = 0; i < 4; i++)
+					pole[i] = single + n * ((1 << i) - 1) + (j << i);
+				Kernels::hierarchize_poles(pole, 3, types[k] == GRID_BOUNDARY ? left + j : NULL,
+					types[k] == GRID_BOUNDARY ? right + j : NULL, 1, 1, types[k], 0);
+			}
+			for (j = 0; j < 15 * n; j++)
+				if (fabs(poles[j] - single[j]) > 0.0001)
+					b = 1;
+			Kernels::hierarchize_poles(blocks, 3, types[k] == GRID_BOUNDARY ? left : NULL,
+				types[k] == GRID_BOUNDARY ? right : NULL, n, 1, types[k], 1);
+			for (j = 0; j < 15 * n; j++)
+				if (fabs(poles[j] - group[j]) > 0.0001)
+					b = 1;
+
+			/* conversions round trip */
+			Converter::bulk_coord2li(&coords[0], n, &levels[0], &indices[0], d);
+			Converter::bulk_li2coord(&levels[0], &indices[0], n, &back[0], d);
+			for (j = 0; j < n * d; j++)
+				if (back[j] != coords[j])
+					b = 1;
+		}
+	}
+
+	Kernels::select(initial);
+
+	/* the dots fill up to the column of the other results, whatever the length of the name */
+	std::string label = std::string("Kernel dispatch test (") + Kernels::name(initial) + ") ";
+	label.append(label.size() < 42 ? 42 - label.size() : 1, '.');
+
+	if (!b) {
+		cout << label << " [passed]" << endl;
+		return 0;
+	} else {
+		cout << label << " [failed]" << endl;
+		return 1;
+	}
+}
+
+/*
+ * test the pole hierarchization: interpolation at the grid points, and the point-wise dehierarchization undoes it
+ */
+int testPoles(int d, int l)
+{
+	int b = 0, i, j, k, n = 32;
+	SampleFct fct(d);
+	GridType types[3] = { GRID_BOUNDARY, GRID_ZERO_BOUNDARY, GRID_MODIFIED };
+	float coords[n * d], expected[n], vals[n], gp[d];
+
+	srand(d * 100 + l);
+	for (i = 0; i < n * d; i++)
+		coords[i] = (float) rand() / RAND_MAX;
+
+	for (k = 0; k < 3; k++) {
+		SparseGrid sg(l, &fct, types[k]);
+		sg.hierarchize();
+
+		for (i = 0; i < sg.size(); i += 1 + sg.size() / 499) {
+			if (types[k] == GRID_BOUNDARY)
+				Converter::idx2gp(i, gp, d, l);
+			else
+				Converter::zb_idx2gp(i, gp, d);
+			if (fabs(sg.evaluate(gp) - fct.getValue(gp)) > 0.0001 * fabs(fct.getValue(gp)) + 0.0001)
+				b = 1;
+		}
+
+		sg.evaluate(coords, n, expected);
+		sg.dehierarchize();
+		sg.hierarchize();
+		sg.evaluate(coords, n, vals);
+		for (j = 0; j < n; j++)
+			if (fabs(vals[j] - expected[j]) > 0.0001 * fabs(expected[j]) + 0.0001)
+				b = 1;
+	}
+
+	if (!b) {
+		cout << "Pole hierarchization test ................ [passed]" << endl;
+		return 0;
+	} else {
+		cout << "Pole hierarchization test ................ [failed]" << endl;
+		return 1;
+	}
+}
+
+/*
+ * test that one plan hierarchizes several grids of the same shape, and external arrays
+ */
+int testPlan(int d, int l)
+{
+	int b = 0, i, j, k, n = 32;
+	SampleFct fct(d);
+	LinearFct lfct(d);
+	GridType types[3] = { GRID_BOUNDARY, GRID_ZERO_BOUNDARY, GRID_MODIFIED };
+	float coords[n * d], expected, gp[d];
+
+	srand(d * 100 + l);
+	for (i = 0; i < n * d; i++)
+		coords[i] = (float) rand() / RAND_MAX;
+
+	for (k = 0; k < 3; k++) {
+		HierarchizationPlan plan(d, l, types[k]);
+		SparseGrid sg(l, &fct, types[k]), ref(l, &fct, types[k]);
+		SparseGrid lsg(l, &lfct, types[k]), lref(l, &lfct, types[k]);
+		HierarchizationPlan other(d, l + 1, types[k]);
+
+		if (plan.size() != sg.size() || sg.hierarchize(&other) != -1)
+			b = 1;
+
+		sg.hierarchize(&plan);
+		lsg.hierarchize(&plan);
+		ref.hierarchize();
+		lref.hierarchize();
+		for (j = 0; j < n; j++) {
+			expected = ref.evaluate(coords + j * d);
+			if (fabs(sg.evaluate(coords + j * d) - expected) > 0.0001 * fabs(expected) + 0.0001)
+				b = 1;
+			expected = lref.evaluate(coords + j * d);
+			if (fabs(lsg.evaluate(coords + j * d) - expected) > 0.0001 * fabs(expected) + 0.0001)
+				b = 1;
+		}
+
+		/* an external array of function values goes there and back */
+		std::vector<float> values(plan.size()), copy;
+		for (i = 0; i < plan.size(); i++) {
+			if (types[k] == GRID_BOUNDARY)
+				Converter::idx2gp(i, gp, d, l);
+			else
+				Converter::zb_idx2gp(i, gp, d);
+			values[i] = fct.getValue(gp);
+		}
+		copy = values;
+		plan.hierarchize(&values[0]);
+		plan.dehierarchize(&values[0]);
+		for (i = 0; i < plan.size(); i++)
+			if (fabs(values[i] - copy[i]) > 0.0001 * fabs(copy[i]) + 0.0001)
+				b = 1;
+	}
+
+	if (!b) {
+		cout << "Hierarchization plan test ................ [passed]" << endl;
+		return 0;
+	} else {
+		cout << "Hierarchization plan test ................ [failed]" << endl;
+		return 1;
+	}
+}
+
+/*
+ * test the grids built from nodal values (copied or wrapped) over the exported coordinates
+ */
+int testExternal(int d, int l)
+{
+	int b = 0, i, j, k, n = 32;
+	SampleFct fct(d);
+	GridType types[3] = { GRID_BOUNDARY, GRID_ZERO_BOUNDARY, GRID_MODIFIED };
+	float coords[n * d], expected;
+
+	srand(d * 100 + l);
+	for (i = 0; i < n * d; i++)
+		coords[i] = (float) rand() / RAND_MAX;
+
+	for (k = 0; k < 3; k++) {
+		SparseGrid ref(l, &fct, types[k]);
+		std::vector<float> gp(ref.size() * d + 1), values(ref.size() + 1), wrapped;
+
+		/* the nodal values computed in bulk at the exported points */
+		if (SparseGrid::coordinates(d, l, types[k], &gp[0]))
+			b = 1;
+		for (i = 0; i < ref.size(); i++)
+			values[i] = fct.getValue(&gp[i * d]);
+		wrapped = values;
+
+		SparseGrid copied(d, l, &values[0], types[k]);
+		SparseGrid *wrap = new SparseGrid(d, l, &wrapped[0], types[k], BUFFER_WRAP);
+		if (copied.size() != ref.size() || wrap->size() != ref.size() || wrap->getBacking() != ALLOC_CUSTOM)
+			b = 1;
+
+		ref.hierarchize();
+		copied.hierarchize();
+		wrap->hierarchize();
+		for (j = 0; j < n; j++) {
+			expected = ref.evaluate(coords + j * d);
+			if (fabs(copied.evaluate(coords + j * d) - expected) > 0.0001 * fabs(expected) + 0.0001
+					|| fabs(wrap->evaluate(coords + j * d) - expected) > 0.0001 * fabs(expected) + 0.0001)
+				b = 1;
+		}
+
+		/* the wrapped buffer was hierarchized in place, the copied one was not touched */
+		if (ref.size() > 1 && wrapped == values)
+			b = 1;
+		for (i = 0; i < ref.size(); i++)
+			if (values[i] != fct.getValue(&gp[i * d]))
+				b = 1;
+		wrap->dehierarchize();
+		for (i = 0; i < ref.size(); i++)
+			if (fabs(wrapped[i] - values[i]) > 0.0001 * fabs(values[i]) + 0.0001)
+				b = 1;
+
+		/* refining moves the coefficients to memory of the grid, the buffer stays with the caller */
+		if (wrap->refineLevel(&fct) || wrap->getBacking() == ALLOC_CUSTOM)
+			b = 1;
+		delete wrap;
+	}
+
+	if (!b) {
+		cout << "External values test ..................... [passed]" << endl;
+		return 0;
+	} else {
+		cout << "External values test ..................... [failed]" << endl;
+		return 1;
+	}
+}
+
+/*
+ * test moving grids and evaluating one shared grid from several threads
+ */
+int testShared(int d, int l)
+{
+	int b = 0, i, j, n = 64, threads = 4;
+	SampleFct fct(d);
+	float coords[n * d], expected[n], single[n];
+	std::atomic<int> errors(0);
+	std::vector<std::thread> readers;
+
+	srand(d * 100 + l);
+	for (i = 0; i < n * d; i++)
+		coords[i] = (float) rand() / RAND_MAX;
+
+	SparseGrid ref(l, &fct);
+	ref.hierarchize();
+	ref.evaluate(coords, n, expected);
+	for (j = 0; j < n; j++)
+		single[j] = ref.evaluate(coords + j * d);
+
+	/* the moved-from grids are left empty and are destroyed safely at the end of the scope */
+	SparseGrid a(l, &fct);
+	a.hierarchize();
+	SparseGrid moved(std::move(a));
+	SparseGrid c(l, &fct, GRID_ZERO_BOUNDARY);
+	c = std::move(moved);
+	if (a.size() != 0 || moved.size() != 0 || c.size() != ref.size() || c.getType() != GRID_BOUNDARY)
+		b = 1;
+	for (j = 0; j < n; j++)
+		if (c.evaluate(coords + j * d) != single[j])
+			b = 1;
+
+	SharedSparseGrid shared(std::move(c));
+	if (c.size() != 0 || shared.size() != ref.size() || shared.useCount() != 1)
+		b = 1;
+
+	/* every thread holds its own handle; the handle of this thread is dropped while they run */
+	for (i = 0; i < threads; i++)
+		readers.push_back(std::thread([shared, &coords, &expected, &single, &errors, n, d]() {
+			float vals[n];
+			int r, k;
+
+			for (r = 0; r < 20; r++) {
+				if (shared.evaluate(coords, n, vals))
+					errors++;
+				for (k = 0; k < n; k++)
+					if (vals[k] != expected[k] || shared.evaluate(coords + k * d) != single[k])
+						errors++;
+			}
+		}));
+	const SparseGrid *grid = shared.get();
+	shared = SharedSparseGrid(new SparseGrid(l, &fct));
+	for (i = 0; i < threads; i++)
+		readers[i].join();
+	if (errors.load() != 0 || shared.get() == grid || shared.useCount() != 1)
+		b = 1;
+
+	SharedSparseGrid copy = shared;
+	if (copy.get() != shared.get() || shared.useCount() != 2)
+		b = 1;
+
+	if (!b) {
+		cout << "Shared grid test ......................... [passed]" << endl;
+		return 0;
+	} else {
+		cout << "Shared grid test ......................... [failed]" << endl;
+		return 1;
+	}
+}
+
+/*
+ * test single points evaluated by several threads
+ */
+int testParallelPoint(int d, int l)
+{
+	int b = 0, i, j, k, n = 16, lv;
+	SampleFct fct(d);
+	GridType types[3] = { GRID_BOUNDARY, GRID_ZERO_BOUNDARY, GRID_MODIFIED };
+	int threads[3] = { 2, 3, 8 };
+	float coords[n * d], val, expected;
+
+	srand(d * 100 + l);
+	for (i = 0; i < n * d; i++)
+		coords[i] = (float) rand() / RAND_MAX;
+
+	/* the interior grids get finer, so that their sparse grid is split into several tasks */
+	for (k = 0; k < 3; k++) {
+		lv = types[k] == GRID_BOUNDARY ? l : l + 4;
+		SparseGrid sg(lv, &fct, types[k]);
+		sg.hierarchize();
+
+		for (j = 0; j < n; j++) {
+			val = sg.evaluate(coords + j * d, 1);
+			expected = sg.evaluate(coords + j * d);
+			if (fabs(val - expected) > 0.0001 * fabs(expected) + 0.0001)
+				b = 1;
+			/* the partial sums are added in the same order whatever the number of threads */
+			for (i = 0; i < 3; i++)
+				if (sg.evaluate(coords + j * d, threads[i]) != val)
+					b = 1;
+		}
+
+		/* two callers at once: one of them gets the pool, the other one runs its tasks alone */
+		std::vector<float> vals(2 * n);
+		std::thread other([&]() {
+			for (int m = 0; m < n; m++)
+				vals[n + m] = sg.evaluate(coords + m * d, 3);
+		});
+		for (j = 0; j < n; j++)
+			vals[j] = sg.evaluate(coords + j * d, 3);
+		other.join();
+		for (j = 0; j < n; j++)
+			if (vals[j] != vals[n + j] || vals[j] != sg.evaluate(coords + j * d, 1))
+				b = 1;
+	}
+
+	/* the workers are started once and kept, whatever the number of queries */
+	if (TaskPool::shared()->getWorkers() > 7)
+		b = 1;
+
+	/* below one task the serial evaluation is used */
+	SparseGrid small(1, &fct);
+	small.hierarchize();
+	for (j = 0; j < n; j++)
+		if (small.evaluate(coords + j * d, 8) != small.evaluate(coords + j * d))
+			b = 1;
+
+	if (!b) {
+		cout << "Parallel point test ...................... [passed]" << endl;
+		return 0;
+	} else {
+		cout << "Parallel point test ...................... [failed]" << endl;
+		return 1;
+	}
+}
+
+int testInstrumentation(int d, int l)
+{
+	int b = 0, i, j, k, pd, kk;
+	unsigned long long expected, events;
+	SampleFct fct(d);
+	GridType types[2] = { GRID_BOUNDARY, GRID_ZERO_BOUNDARY };
+	float coords[d];
+	inst_stats_t st;
+
+	for (i = 0; i < d; i++)
+		coords[i] = 0.3f + 0.1f * i / d;
+
+	if (!Instrumentation::enabled()) {
+		/* compiled out: nothing is counted and snapshot says so */
+		if (Instrumentation::snapshot(&st) != -1)
+			b = 1;
+		for (i = 0; i < INST_NUM_COUNTERS; i++)
+			if (st.counters[i])
+				b = 1;
+		for (i = 0; i < INST_NUM_OPS; i++)
+			if (st.calls[i])
+				b = 1;
+	}
+
+	for (k = 0; Instrumentation::enabled() && k < 2; k++) {
+		SparseGrid sg(l, &fct, types[k]);
+		sg.hierarchize();
+
+		/* one evaluation visits every subspace of every sub-grid once, one coefficient each */
+		expected = 0;
+		for (pd = d; pd >= (types[k] == GRID_BOUNDARY ? 0 : d); pd--)
+			for (kk = 0; kk < (1 << (d - pd)) * Helper::combi(d, d - pd); kk++)
+				for (i = 0; i < (pd == 0 ? 1 : l); i++)
+					expected += pd == 0 ? 1 : Helper::combi(pd - 1 + i, i);
+
+		Instrumentation::reset();
+		sg.evaluate(coords);
+		if (Instrumentation::snapshot(&st))
+			b = 1;
+		if (st.counters[INST_SUBSPACES] != expected || st.counters[INST_COEFFICIENTS] != expected)
+			b = 1;
+		if (st.calls[INST_OP_EVALUATE] != 1 || st.calls[INST_OP_EVALUATE_BATCH] != 0)
+			b = 1;
+		for (j = 0, events = 0; j < INST_HISTOGRAM_BUCKETS; j++)
+			events += st.histogram[INST_OP_EVALUATE][j];
+		if (events != 1)
+			b = 1;
+
+		/* a new interval starts from zero */
+		Instrumentation::reset();
+		Instrumentation::snapshot(&st);
+		for (i = 0; i < INST_NUM_COUNTERS; i++)
+			if (st.counters[i])
+				b = 1;
+		for (i = 0; i < INST_NUM_OPS; i++) {
+			if (st.calls[i] || st.latency_ns[i])
+				b = 1;
+			for (j = 0; j < INST_HISTOGRAM_BUCKETS; j++)
+				if (st.histogram[i][j])
+					b = 1;
+		}
+	}
+
+	if (!b) {
+		cout << "Instrumentation test ..................... [passed]" << endl;
+		return 0;
+	} else {
+		cout << "Instrumentation test ..................... [failed]" << endl;
+		return 1;
+	}
+}
+
 /*
  * test hierarchization and evaluation return correct results
  */
@@ -298,6 +1866,29 @@ int main()
 				if (testidx2gp(d, l)) throw 2;
 				if (testBijection(d, l)) throw 3;
 				if (testSparseGridOps(d, l)) throw 4;
+				if (testBulkConversions(d, l)) throw 5;
+				if (testZeroBoundary(d, l)) throw 6;
+				if (testOutOfCore(d, l)) throw 7;
+				if (testNuma(d, l)) throw 8;
+				if (testAllocators(d, l)) throw 9;
+				if (testVersioned(d, l)) throw 10;
+				if (testService(d, l)) throw 11;
+				if (testUpdate(d, l)) throw 12;
+				if (testTruncated(d, l)) throw 13;
+				if (testReordering(d, l)) throw 14;
+				if (testModified(d, l)) throw 15;
+				if (testRefineLevel(d, l)) throw 16;
+				if (testCoarsen(d, l)) throw 17;
+				if (testMarginalize(d, l)) throw 18;
+				if (testSlice(d, l)) throw 19;
+				if (testTensor(d, l)) throw 20;
+				if (testKernels(d, l)) throw 21;
+				if (testPoles(d, l)) throw 22;
+				if (testPlan(d, l)) throw 23;
+				if (testExternal(d, l)) throw 24;
+				if (testShared(d, l)) throw 25;
+				if (testParallelPoint(d, l)) throw 26;
+				if (testInstrumentation(d, l)) throw 27;
 		
 				cout << endl;
 			}
@@ -0,0 +1,156 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2010, 2011 Alin Murarasu, Aurora Mirea
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+/*
+ * Tests of the distributed sparse grid; run with several ranks, e.g. mpirun -np 4 ./testmpi (make mpi-check)
+ */
+
+#include <stdlib.h>
+#include <math.h>
+
+#include <iostream>
+
+#include <mpi.h>
+
+#include "SparseGrid.h"
+#include "DistributedSparseGrid.h"
+#include "Converter.h"
+
+using namespace std;
+
+using namespace fsg;
+
+class SampleFct : public Function
+{
+	private:
+		int d;
+
+	public:
+		SampleFct(int d) { this->d = d; }
+
+		int getD() { return d; }
+
+		float getValue(float *coords)
+		{
+			int i;
+			float prod = 1;
+
+			for (i = 0; i < d; i++)
+				prod *= (3 - coords[i]) * (2 - coords[i]);
+
+			return prod;
+		}
+};
+
+/*
+ * test that the distributed grid gives the same results as the in-core one, on every rank
+ */
+int testDistributed(int d, int l, GridType type, int rank)
+{
+	int b = 0, i, j, all;
+	SampleFct fct(d);
+	SparseGrid sg(l, &fct, type);
+	DistributedSparseGrid dsg(l, &fct, MPI_COMM_WORLD, type);
+	int bs = 64;
+	float coords[bs][d], vals[bs], dvals[bs];
+
+	sg.hierarchize();
+	dsg.hierarchize();
+
+	if (dsg.size() != sg.size())
+		b = 1;
+
+	/* interpolation property at the grid points */
+	for (i = 0; i < dsg.size(); i += 1 + dsg.size() / 97) {
+		if (type == GRID_ZERO_BOUNDARY)
+			Converter::zb_idx2gp(i, coords[0], d);
+		else
+			Converter::idx2gp(i, coords[0], d, l);
+		if (fabs(dsg.evaluate(coords[0]) - fct.getValue(coords[0])) > 0.001 * fabs(fct.getValue(coords[0])))
+			b = 1;
+	}
+
+	/* the same random points on all ranks */
+	srand(d * 100 + l);
+	for (i = 0; i < bs; i++)
+		for (j = 0; j < d; j++)
+			coords[i][j] = (float) rand() / RAND_MAX;
+
+	sg.evaluate((float *) coords, bs, vals);
+	if (dsg.evaluate((float *) coords, bs, dvals))
+		b = 1;
+	for (i = 0; i < bs; i++)
+		if (fabs(dvals[i] - vals[i]) > 0.0001 * fabs(vals[i]) + 0.00001)
+			b = 1;
+
+	MPI_Allreduce(&b, &all, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+
+	if (rank == 0) {
+		if (!all)
+			cout << "Distributed " << (type == GRID_ZERO_BOUNDARY ? "0-boundary " : "") << "grid test ...... [passed]" << endl;
+		else
+			cout << "Distributed " << (type == GRID_ZERO_BOUNDARY ? "0-boundary " : "") << "grid test ...... [failed]" << endl;
+	}
+
+	return all;
+}
+
+int main(int argc, char **argv)
+{
+	int maxDim = 5, maxL = 5;
+	int rank, ranks, failed = 0;
+
+	MPI_Init(&argc, &argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+	try {
+		for (int d = 1; d <= maxDim; d++)
+			for (int l = 1; l <= maxL; l++) {
+				if (rank == 0) {
+					cout << "Testing d = " << d << ", l = " << l << ", " << ranks << " ranks" << endl;
+					cout << "---------------------------------------------------" << endl;
+				}
+
+				if (testDistributed(d, l, GRID_BOUNDARY, rank)) throw 1;
+				if (testDistributed(d, l, GRID_ZERO_BOUNDARY, rank)) throw 2;
+
+				if (rank == 0)
+					cout << endl;
+			}
+
+		if (rank == 0)
+			cout << "Success" << endl;
+	}
+	catch (int e) {
+		if (rank == 0)
+			std::cout << "Test number "<< e <<" failed" << endl;
+		failed = 1;
+	}
+
+	MPI_Finalize();
+
+	return failed;
+}
@@ -0,0 +1,218 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2009, 2010 Alin Murarasu
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+#include "Allocator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+using namespace fsg;
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+#define HUGE_2MB (1UL << 21)
+
+static size_t round_up(size_t size, size_t unit)
+{
+	return (size + unit - 1) / unit * unit;
+}
+
+/* explicit huge pages of 2^shift bytes from the hugetlbfs pool */
+static void *map_hugetlb(size_t size, int shift)
+{
+#ifdef MAP_HUGETLB
+	void *p = mmap(NULL, round_up(size, 1UL << shift), PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (shift << MAP_HUGE_SHIFT), -1, 0);
+
+	return p == MAP_FAILED ? NULL : p;
+#else
+	return NULL;
+#endif
+}
+
+/* 2 MB aligned anonymous memory the kernel is asked to back with transparent huge pages */
+static void *map_transparent(size_t size)
+{
+#ifdef MADV_HUGEPAGE
+	size_t len = round_up(size, HUGE_2MB);
+	char *q, *a;
+
+	/* over-allocate by 2 MB and trim both ends to get the alignment */
+	q = (char *) mmap(NULL, len + HUGE_2MB, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (q == MAP_FAILED)
+		return NULL;
+	a = (char *) round_up((size_t) q, HUGE_2MB);
+	if (a > q)
+		munmap(q, a - q);
+	if (q + HUGE_2MB > a)
+		munmap(a + len, q + HUGE_2MB - a);
+
+	if (madvise(a, len, MADV_HUGEPAGE)) {
+		munmap(a, len);
+		return NULL;
+	}
+
+	return a;
+#else
+	return NULL;
+#endif
+}
+
+Allocator::Allocator(AllocKind kind)
+{
+	this->kind = kind;
+}
+
+Allocator::~Allocator()
+{
+}
+
+void *Allocator::allocate(size_t size, AllocKind *backing)
+{
+	void *p;
+
+	if (size == 0)
+		size = 1;
+
+	/* every kind falls back to the next weaker one */
+	switch (kind) {
+	case ALLOC_HUGE_1GB:
+		if ((p = map_hugetlb(size, 30)) != NULL) {
+			*backing = ALLOC_HUGE_1GB;
+			return p;
+		}
+		/* fall through */
+	case ALLOC_HUGE_2MB:
+		if ((p = map_hugetlb(size, 21)) != NULL) {
+			*backing = ALLOC_HUGE_2MB;
+			return p;
+		}
+		/* fall through */
+	case ALLOC_HUGE_TRANSPARENT:
+		if ((p = map_transparent(size)) != NULL) {
+			*backing = ALLOC_HUGE_TRANSPARENT;
+			return p;
+		}
+		/* fall through */
+	case ALLOC_ALIGNED:
+		if (posix_memalign(&p, 64, size))
+			return NULL;
+		*backing = ALLOC_ALIGNED;
+		return p;
+	default:
+		*backing = ALLOC_DEFAULT;
+		return malloc(size);
+	}
+}
+
+void Allocator::release(void *p, size_t size, AllocKind backing)
+{
+	if (p == NULL)
+		return;
+	if (size == 0)
+		size = 1;
+
+	switch (backing) {
+	case ALLOC_HUGE_1GB:
+		munmap(p, round_up(size, 1UL << 30));
+		break;
+	case ALLOC_HUGE_2MB:
+	case ALLOC_HUGE_TRANSPARENT:
+		munmap(p, round_up(size, HUGE_2MB));
+		break;
+	default:
+		free(p);
+		break;
+	}
+}
+
+AllocKind Allocator::getKind()
+{
+	return kind;
+}
+
+const char *Allocator::name(AllocKind kind)
+{
+	switch (kind) {
+	case ALLOC_DEFAULT:
+		return "default";
+	case ALLOC_ALIGNED:
+		return "aligned";
+	case ALLOC_HUGE_TRANSPARENT:
+		return "huge_transparent";
+	case ALLOC_HUGE_2MB:
+		return "huge_2mb";
+	case ALLOC_HUGE_1GB:
+		return "huge_1gb";
+	case ALLOC_CUSTOM:
+		return "custom";
+	}
+
+	return "unknown";
+}
+
+size_t Allocator::hugePageBytes(void *p, size_t size)
+{
+	char line[512];
+	unsigned long start = 0, end = 0, lo, hi, kb;
+	unsigned long first = (unsigned long) p, last = (unsigned long) p + size;
+	size_t bytes = 0;
+	int inside = 0;
+	FILE *f = fopen("/proc/self/smaps", "r");
+
+	if (f == NULL)
+		return 0;
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		/* a new mapping starts with its address range */
+		if (sscanf(line, "%lx-%lx ", &lo, &hi) == 2 && strchr(line, '-') < strchr(line, ' ')) {
+			start = lo;
+			end = hi;
+			inside = start < last && end > first;
+			continue;
+		}
+		if (!inside)
+			continue;
+		/* hugetlbfs mappings are entirely huge; otherwise count the transparent huge pages */
+		if (sscanf(line, "KernelPageSize: %lu kB", &kb) == 1 && kb >= 2048)
+			bytes += (end < last ? end : last) - (start > first ? start : first);
+		else if (sscanf(line, "AnonHugePages: %lu kB", &kb) == 1)
+			bytes += kb * 1024;
+	}
+	fclose(f);
+
+	return bytes < size ? bytes : size;
+}
+
+Allocator *Allocator::standard()
+{
+	static Allocator allocator(ALLOC_DEFAULT);
+
+	return &allocator;
+}
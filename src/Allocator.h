@@ -0,0 +1,110 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2009, 2010 Alin Murarasu
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+#ifndef ALLOCATOR_H_
+#define ALLOCATOR_H_
+
+#include <stddef.h>
+
+namespace fsg
+{
+	/* kinds of memory backing the coefficients */
+	enum AllocKind {
+		ALLOC_DEFAULT = 0,	/* malloc */
+		ALLOC_ALIGNED,		/* 64-byte aligned (cache line / widest SIMD load) */
+		ALLOC_HUGE_TRANSPARENT,	/* 2 MB aligned anonymous memory advised for transparent huge pages */
+		ALLOC_HUGE_2MB,		/* explicit 2 MB huge pages (hugetlbfs pool) */
+		ALLOC_HUGE_1GB,		/* explicit 1 GB huge pages (hugetlbfs pool) */
+		ALLOC_CUSTOM		/* provided by a subclass of Allocator, or by the caller (BUFFER_WRAP) */
+	};
+
+	/**
+	 * @class Allocator
+	 *
+	 * @brief Allocation policy for the coefficient arrays
+	 *
+	 * A request that cannot be satisfied falls back to the next weaker kind
+	 * (1 GB -> 2 MB -> transparent -> aligned); allocate reports what was obtained.
+	 * Callers can provide their own memory by overriding allocate and release.
+	 *
+	 */
+	class Allocator
+	{
+		public:
+			/**
+			 * Class constructor
+			 * @param kind The requested kind of memory
+			 */
+			Allocator(AllocKind kind = ALLOC_DEFAULT);
+
+			/**
+			 * Class destructor
+			 */
+			virtual ~Allocator();
+
+			/**
+			 * @param size Size in bytes
+			 * @param backing Receives the kind of memory actually obtained
+			 * @return The memory (at least 64-byte aligned unless the kind is ALLOC_DEFAULT), NULL on failure
+			 */
+			virtual void *allocate(size_t size, AllocKind *backing);
+
+			/**
+			 * @param p Memory returned by allocate
+			 * @param size The size given to allocate
+			 * @param backing The backing reported by allocate
+			 */
+			virtual void release(void *p, size_t size, AllocKind backing);
+
+			/**
+			 * @return The requested kind of memory
+			 */
+			AllocKind getKind();
+
+			/**
+			 * @param kind A kind of memory
+			 * @return Its name, e.g. "huge_2mb"
+			 */
+			static const char *name(AllocKind kind);
+
+			/**
+			 * Inspects /proc/self/smaps
+			 * @param p Start of a memory region
+			 * @param size Size of the region in bytes
+			 * @return The number of bytes of the region currently backed by huge pages (transparent or explicit)
+			 */
+			static size_t hugePageBytes(void *p, size_t size);
+
+			/**
+			 * @return The allocator used when none is given (malloc)
+			 */
+			static Allocator *standard();
+
+		private:
+			AllocKind kind;
+	};
+}
+
+#endif /* ALLOCATOR_H_ */
@@ -25,78 +25,87 @@
 
 #include "Converter.h"
 #include "Helper.h"
+#include "Kernels.h"
+#include "Instrumentation.h"
+#include "Layout.h"
+
+#include <stdlib.h>
+#include <string.h>
 
 using namespace fsg;
 
-/* zero boundary gp2idx */
-int Converter::zb_gp2idx(int *levels, int *indices, int d)
+/*
+ * The source of the binomial coefficients of the bulk conversions (see Layout.h): Helper::combi for every
+ * argument pair the conversions use (including the out-of-range ones, for which combi has its own conventions),
+ * the sizes of the 0-boundary sparse grids and of the groups of sparse grids with the same number of boundary
+ * dimensions, all looked up in tables.
+ */
+class ConversionTables
 {
-	int index1, index2, index3, i, sum;
+	public:
+		typedef int index_t;
+		int d, n, w;
+		int *binom, *zsizes, *groups;
+
+		ConversionTables(int d, int n)
+		{
+			int a, b;
+
+			this->d = d;
+			this->n = n;
+			w = d + n + 4;
+			binom = (int *) malloc(w * w * sizeof(int));
+			zsizes = (int *) malloc((d + 1) * sizeof(int));
+			groups = (int *) malloc((d + 2) * sizeof(int));
+
+			for (a = -1; a < w - 1; a++)
+				for (b = -1; b < w - 1; b++)
+					binom[(a + 1) * w + b + 1] = Helper::combi(a, b);
+			for (a = 0; a <= d; a++)
+				zsizes[a] = Helper::zerob_size(a, n);
+			for (a = 0; a <= d; a++)
+				groups[a] = (1 << a) * combi(d, a) * zsizes[d - a];
+			/* stops the search for the group of a position at the end of the grid */
+			groups[d + 1] = 0x7fffffff;
+		}
 
-	sum = 0;
-	index2 = 0;
+		~ConversionTables()
+		{
+			free(binom);
+			free(zsizes);
+			free(groups);
+		}
 
-	index1 = indices[0];
-		for (i = 1; i < d; i++)
-			index1 = (index1 << levels[i]) + indices[i];
+		inline int combi(int a, int b) const
+		{
+			return binom[(a + 1) * w + b + 1];
+		}
 
-	for (i = 0; i < d - 1; i++) {
-		sum += levels[i];
-		if (sum > 0)
-			index2 += Helper::combi(i + sum, sum - 1);
-	}
-	sum += levels[i];
-	index2 <<= sum;
-	index3 = 0;
-	for (i = 0; i < sum; i++) {
-		index3 += (1 << i) * Helper::combi(d - 1 + i, i);
-	}
+		inline int zsize(int pd) const
+		{
+			return zsizes[pd];
+		}
 
-	return index1 + index2 + index3;
+		inline int groupSize(int n01) const
+		{
+			return groups[n01];
+		}
+};
+
+/* zero boundary gp2idx */
+int Converter::zb_gp2idx(int *levels, int *indices, int d)
+{
+	FSG_INST(Instrumentation::add(INST_CONVERSIONS, 1);)
+
+	return layout_zb_gp2idx(DirectLayout<int>(d, 0), levels, indices, d);
 }
 
 /* zero boundary idx2gp */
 int Converter::zb_idx2gp(int index, int *levels, int *indices, int d)
 {
-	int i, j, f, isum, sum, level, dindex, rest;
+	FSG_INST(Instrumentation::add(INST_CONVERSIONS, 1);)
 
-	f = 1;
-	isum = 0;
-	i = 0;
-	while (index >= isum + Helper::combi(d - 1 + i, i) * f) {
-		isum += Helper::combi(d - 1 + i, i) * f;
-		f *= 2;
-		i++;
-	}
-
-	sum = i;
-	index -= isum;
-	rest = index % (1 << i);
-	index /= (1 << i);
-
-	for (i = d - 2; i >= 0; i--) {
-		isum = 0;
-		j = 0;
-		while (index >= isum + Helper::combi(i + j, j)) {
-			isum += Helper::combi(i + j, j);
-			j++;
-		}
-		level = sum - j;
-		sum = j;
-		f = (1 << level);
-		dindex = rest % f;
-		rest /= f;
-		levels[i + 1] = level;
-		indices[i + 1] = dindex;
-		index -= isum;
-	}
-
-	level = sum;
-	f = (1 << level);
-	dindex = rest % f;
-	rest /= f;
-	levels[0] = level;
-	indices[0] = dindex;
+	layout_zb_idx2gp(DirectLayout<int>(d, 0), index, levels, indices, d);
 
 	return 0;
 }
@@ -105,6 +114,7 @@ int Converter::zb_idx2gp(int index, int *levels, int *indices, int d)
 int Converter::zb_gp2idx(float *coords, int d) {
 	float index1;
 	int index2, index3, i, sum, level;
+	FSG_INST(Instrumentation::add(INST_CONVERSIONS, 1);)
 
 	sum = 0;
 	index1 = index2 = 0;
@@ -131,6 +141,7 @@ int Converter::zb_gp2idx(float *coords, int d) {
 /* zero boundary idx2gp */
 int Converter::zb_idx2gp(int index, float *coords, int d) {
 	int i, j, f, isum, sum, level, dindex, rest;
+	FSG_INST(Instrumentation::add(INST_CONVERSIONS, 1);)
 
 	f = 1;
 	isum = 0;
@@ -171,102 +182,20 @@ int Converter::zb_idx2gp(int index, float *coords, int d) {
 	return 0;
 }
 
-/* non-zero gp2idx, wrapper around zb_gp2idx */
+/* non-zero gp2idx */
 int Converter::gp2idx(int *levels, int *indices, int d, int n)
 {
-	int index1, index2, index3;
-	int pd, n01;
-	int plevels[d], pindices[d];
-	int i;
+	FSG_INST(Instrumentation::add(INST_CONVERSIONS, 1);)
 
-	/* select points on the boundary */
-	pd = 0;
-	for (i = 0; i < d; i++)
-		if (levels[i] != -1) {
-			plevels[pd] = levels[i];
-			pindices[pd++] = indices[i];
-		}
-	if (pd) {
-		index1 = Converter::zb_gp2idx(plevels, pindices, pd);
-	}
-	else
-		index1 = 0;
-
-	/* select the right 0-boundary sparse grid (its beginning) */
-	index2 = 0;
-	n01 = d - pd;
-	for (i = 0; i < d; i++) {
-		if (levels[i] != -1) {
-			index2 += (1 << n01) * Helper::combi(d - i - 1, n01 - 1);
-		}
-		else {
-			n01--;
-
-			if (indices[i] == 1)
-				index2 += (1 << n01) * Helper::combi(d - i - 1, n01);
-			}
-	}
-	index2 *= Helper::zerob_size(pd, n);
-
-	/* count the number of grid points preceeding the group of 0-boundary sparse grids that contains the grid point */
-	index3 = 0;
-
-	for (i = 0; i < d - pd; i++) {
-		index3 += (1 << i) * Helper::combi(d, i) * Helper::zerob_size(d-i, n);
-	}
-	return index1 + index2 + index3;
+	return layout_gp2idx(DirectLayout<int>(d, n), levels, indices);
 }
 
 /* for a given index, returns equivalent (levels, indices) representation */
 int Converter::idx2gp(int index, int *levels, int *indices, int d, int n)
 {
-	int i = 0, j;
-	int n01, pd;
-	int index1, index2;
-	int plevels[d], pindices[d];
-
-	/* after the while, i contains the number of -1 components in levels */
-	while (index >= (1 << i) * Helper::combi(d, i) * Helper::zerob_size(d - i, n)) {
-
-		index -= (1 << i) * Helper::combi(d, i) * Helper::zerob_size(d - i, n);
-
-		i++;
-	}
-
-	n01 = i;
-	for (i = 0; i < d; i++)
-		levels[i] = 0;
-
-	/* pd is the dimensionality of the projection that contains the grid point given by index */
-	pd = d - n01;
-
-	/* index1 is the index inside the sparse grid */
-	index1 = index % Helper::zerob_size(pd, n);
-	/* index2 is the index of the sparse grid from the beginning of its group */
-	index2 = index / Helper::zerob_size(pd, n);
+	FSG_INST(Instrumentation::add(INST_CONVERSIONS, 1);)
 
-	/* convert index1 to (l, i) representation for the projection */
-
-	Converter::zb_idx2gp(index1, plevels, pindices, pd);
-
-	/* find the positions in levels of the -1 components and more... */
-	j = 0;
-	for (i = 0; i < d; i++) {
-		if (index2 >= (1 << n01) * Helper::combi(d - i - 1, n01 - 1)) {
-			levels[i] = plevels[j];
-			indices[i] = pindices[j++];
-			index2 -= (1 << n01) * Helper::combi(d - i - 1, n01 - 1);
-		} else {
-			levels[i] = -1;
-			n01--;
-			if (index2 >= (1 << n01) * Helper::combi(d - i - 1, n01)) {
-				indices[i] = 1;
-				index2 -= (1 << n01) * Helper::combi(d - i - 1, n01);
-			} else {
-				indices[i] = 0;
-			}
-		}
-	}
+	layout_idx2gp(DirectLayout<int>(d, n), index, levels, indices);
 
 	return 0;
 }
@@ -275,7 +204,7 @@ int Converter::idx2gp(int index, int *levels, int *indices, int d, int n)
 int Converter::coord2li(float *coords, int *levels, int *indices, int d)
 {
 	int i;
-	float cc;
+	FSG_INST(Instrumentation::add(INST_CONVERSIONS, 1);)
 
 	for (i = 0; i < d; i++) {
 		if (coords[i] == 0.0f) {
@@ -285,13 +214,7 @@ int Converter::coord2li(float *coords, int *levels, int *indices, int d)
 			levels[i] = -1;
 			indices[i] = 1;
 		} else {
-			levels[i] = -1;
-			cc = coords[i];
-			while (cc != (int) cc) {
-				cc *= 2;
-				levels[i]++;
-			}
-			indices[i] = (int) ((cc - 1.0f) / 2.0f);
+			Helper::decode_dyadic(coords[i], levels + i, indices + i);
 		}
 	}
 
@@ -302,6 +225,7 @@ int Converter::coord2li(float *coords, int *levels, int *indices, int d)
 int Converter::li2coord(int *levels, int *indices, float *coords, int d)
 {
 	int i;
+	FSG_INST(Instrumentation::add(INST_CONVERSIONS, 1);)
 
 	for (i = 0; i < d; i++) {
 		if (levels[i] == -1) {
@@ -320,18 +244,11 @@ int Converter::li2coord(int *levels, int *indices, float *coords, int d)
 /* computes the refinement level of x located between in the interval [a, b] */
 int Converter::computeLevel(float x, float a, float b)
 {
-	int i;
-	float r = (x - a) / (b - a), d = 0.5f;
+	int level, index;
 
-	i = 0;
-	while (r != d) {
-		if (r > d)
-			r -= d;
-		d /= 2.0f;
-		i++;
-	}
+	Helper::decode_dyadic((x - a) / (b - a), &level, &index);
 
-	return i;
+	return level;
 }
 
 /* returns the 1d index of the grid point coords */
@@ -351,4 +268,48 @@ int Converter::idx2gp(int index, float *coords, int d, int n)
 	
 	idx2gp(index, levels, indices, d, n);
 	li2coord(levels, indices, coords, d);
+
+	return 0;
+}
+
+int Converter::bulk_gp2idx(int *levels, int *indices, int num, int *idx, int d, int n)
+{
+	ConversionTables t(d, n);
+	int k;
+	FSG_INST(Instrumentation::add(INST_CONVERSIONS, num);)
+
+	for (k = 0; k < num; k++, levels += d, indices += d)
+		idx[k] = layout_gp2idx(t, levels, indices);
+
+	return 0;
+}
+
+int Converter::bulk_idx2gp(int *idx, int num, int *levels, int *indices, int d, int n)
+{
+	ConversionTables t(d, n);
+	int k;
+	FSG_INST(Instrumentation::add(INST_CONVERSIONS, num);)
+
+	for (k = 0; k < num; k++, levels += d, indices += d)
+		layout_idx2gp(t, idx[k], levels, indices);
+
+	return 0;
+}
+
+int Converter::bulk_coord2li(float *coords, int num, int *levels, int *indices, int d)
+{
+	FSG_INST(Instrumentation::add(INST_CONVERSIONS, num);)
+
+	Kernels::coord2li(coords, num * d, levels, indices);
+
+	return 0;
+}
+
+int Converter::bulk_li2coord(int *levels, int *indices, int num, float *coords, int d)
+{
+	FSG_INST(Instrumentation::add(INST_CONVERSIONS, num);)
+
+	Kernels::li2coord(levels, indices, num * d, coords);
+
+	return 0;
 }
@@ -133,6 +133,52 @@ namespace fsg
 			 * @return If successful, returns 0
 			 */
 			static int zb_idx2gp(int index, float *coords, int d);
+
+			/**
+			 * Bulk version of gp2idx; the binomial coefficients are computed once per call
+			 * @param levels The l components of num points (num x d, row-major)
+			 * @param indices The i components of num points (num x d, row-major)
+			 * @param num Number of points
+			 * @param idx The computed indices (of size num)
+			 * @param d Number of dimensions
+			 * @param n Level of refinement
+			 * @return If successful, returns 0
+			 */
+			static int bulk_gp2idx(int *levels, int *indices, int num, int *idx, int d, int n);
+
+			/**
+			 * Bulk version of idx2gp; the binomial coefficients are computed once per call
+			 * @param idx The indices to be converted (of size num)
+			 * @param num Number of indices
+			 * @param levels The computed l components (num x d, row-major)
+			 * @param indices The computed i components (num x d, row-major)
+			 * @param d Number of dimensions
+			 * @param n Level of refinement
+			 * @return If successful, returns 0
+			 */
+			static int bulk_idx2gp(int *idx, int num, int *levels, int *indices, int d, int n);
+
+			/**
+			 * Bulk version of coord2li; branch-free, so the compiler can vectorize it
+			 * @param coords The coordinates of num points (num x d, row-major)
+			 * @param num Number of points
+			 * @param levels The computed l components (num x d, row-major)
+			 * @param indices The computed i components (num x d, row-major)
+			 * @param d Number of dimensions
+			 * @return If successful, returns 0
+			 */
+			static int bulk_coord2li(float *coords, int num, int *levels, int *indices, int d);
+
+			/**
+			 * Bulk version of li2coord; branch-free, so the compiler can vectorize it
+			 * @param levels The l components of num points (num x d, row-major)
+			 * @param indices The i components of num points (num x d, row-major)
+			 * @param num Number of points
+			 * @param coords The computed coordinates (num x d, row-major)
+			 * @param d Number of dimensions
+			 * @return If successful, returns 0
+			 */
+			static int bulk_li2coord(int *levels, int *indices, int num, float *coords, int d);
 		};
 }
 
@@ -0,0 +1,311 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2009, 2010 Alin Murarasu
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+#include "DistributedSparseGrid.h"
+#include "Converter.h"
+#include "Helper.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <algorithm>
+
+using namespace fsg;
+
+/* a subspace (or boundary subspace) used by one pole group during a dimension sweep */
+typedef struct dsg_block_t {
+	int offset;
+	int len;
+	int owner;
+} dsg_block_t;
+
+/* a pole group restricted to the levels 0..K needed by the owned subspaces; see Helper::hierarchize_poles */
+typedef struct dsg_group_t {
+	int first, K, boundary, outer, inner;
+} dsg_group_t;
+
+DistributedSparseGrid::DistributedSparseGrid(int l, Function* f, MPI_Comm comm, GridType type)
+{
+	int i, j, num;
+	int chunk = 4096;
+
+	d = f->getD();
+	this->l = l;
+	this->type = type;
+	this->comm = comm;
+	sg1d = NULL;
+	begin = end = 0;
+
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &ranks);
+
+	try {
+		if (d < 0 || l < 0)
+			throw 1;
+		if (type == GRID_MODIFIED)
+			throw 2;
+		if (type == GRID_ZERO_BOUNDARY)
+			numOfGridPoints = Helper::zerob_size(d, l);
+		else
+			numOfGridPoints = SparseGrid::size(d, l);
+
+		ranges.resize(ranks + 1);
+		Helper::partition(d, l, type, ranks, &ranges[0]);
+		begin = ranges[rank];
+		end = ranges[rank + 1];
+
+		sg1d = (float *) malloc((end - begin + 1) * sizeof(float));
+
+		/* sample f on the local part, chunk by chunk */
+		std::vector<int> idx(chunk), levels(chunk * d + 1), indices(chunk * d + 1);
+		std::vector<float> gp(chunk * d + 1);
+		for (i = begin; i < end; i += chunk) {
+			num = std::min(chunk, end - i);
+			if (type == GRID_ZERO_BOUNDARY) {
+				for (j = 0; j < num; j++)
+					Converter::zb_idx2gp(i + j, &gp[j * d], d);
+			} else {
+				for (j = 0; j < num; j++)
+					idx[j] = i + j;
+				Converter::bulk_idx2gp(&idx[0], num, &levels[0], &indices[0], d, l);
+				Converter::bulk_li2coord(&levels[0], &indices[0], num, &gp[0], d);
+			}
+			for (j = 0; j < num; j++)
+				sg1d[i - begin + j] = f->getValue(&gp[j * d]);
+		}
+	} catch (int e) {
+		if (e == 1)
+			std::cout
+					<< "Exception: number of dimensions and refinement level must be positive!"
+					<< std::endl;
+		else
+			std::cout << "Exception: the modified linear basis is not supported by the distributed grid" << std::endl;
+	}
+}
+
+DistributedSparseGrid::~DistributedSparseGrid()
+{
+	free(sg1d);
+}
+
+float DistributedSparseGrid::evaluate(float *coords)
+{
+	float val = 0.0f;
+
+	evaluate(coords, 1, &val);
+
+	return val;
+}
+
+int DistributedSparseGrid::evaluate(float *coords, int n, float *vals)
+{
+	int i, j;
+
+	for (j = 0; j < n; j++)
+		vals[j] = 0;
+
+	try {
+		for (j = 0; j < n; j++)
+			for (i = 0; i < d; i++)
+				if (coords[j * d + i] > 1 || coords[j * d + i] < 0)
+					throw 1;
+	} catch (int i) {
+		std::cout << "The coordinates are not in [0,1]^d domain" << std::endl;
+
+		return -1;
+	}
+
+	/* partial sums over the local subspaces, then the sum over all ranks */
+	Helper::evaluate_range(sg1d, begin, end, d, l, type, coords, n, vals);
+	MPI_Allreduce(MPI_IN_PLACE, vals, n, MPI_FLOAT, MPI_SUM, comm);
+
+	return 0;
+}
+
+int DistributedSparseGrid::hierarchize()
+{
+	int cd;
+
+	for (cd = 0; cd < d; cd++)
+		if (hierarchize(cd))
+			return -1;
+
+	return 0;
+}
+
+/*
+ * One dimension sweep. The pole groups with owned subspaces are collected first; the parents owned by other
+ * ranks (lower levels of the same pole, or the boundary sparse grids) are then fetched with one exchange.
+ * All of them still hold their values from before the sweep, as the hierarchization needs.
+ */
+int DistributedSparseGrid::hierarchize(int cd)
+{
+	int pd, kk, i, k, o, K, zsize, index1, left, right, more;
+	int levels[d], indices[d], lp[d], offsets[l + 1];
+	std::vector<dsg_group_t> groups;
+	std::vector<dsg_block_t> blocks;
+	std::vector<std::vector<int> > requests(ranks);
+	std::vector<int> scounts(ranks), sdispls(ranks), rcounts(ranks), rdispls(ranks);
+	std::vector<int> fcounts(ranks, 0), fdispls(ranks), gcounts(ranks), gdispls(ranks);
+	std::vector<int> sbuf, rbuf;
+	std::vector<float> reply, ghost;
+	std::vector<float *> poles;
+	dsg_group_t g;
+	dsg_block_t b;
+	size_t j;
+	float *data;
+
+	index1 = 0;
+	for (pd = d; pd >= (type == GRID_ZERO_BOUNDARY ? d : 1); pd--) {
+		zsize = Helper::zerob_size(pd, l);
+		for (kk = 0; kk < (1 << (d - pd)) * Helper::combi(d, d - pd); kk++, index1 += zsize) {
+			if (index1 + zsize <= begin || index1 >= end)
+				continue;
+			Converter::idx2gp(index1, levels, indices, d, l);
+			if (levels[cd] == -1)
+				continue;
+
+			for (i = 0; i < pd - 1; i++)
+				lp[i] = 0;
+			do {
+				K = Helper::pole_group(levels, indices, index1, cd, lp, d, l, type, offsets, &left, &right,
+						&g.outer, &g.inner);
+				more = pd > 1 && Helper::next_levels(lp, pd - 1, l - 1);
+
+				/* the levels above the owned ones are hierarchized by the ranks that own them */
+				while (K >= 0 && offsets[K] >= end)
+					K--;
+				if (K < 0 || offsets[K] < begin)
+					continue;
+
+				g.first = blocks.size();
+				g.K = K;
+				g.boundary = left != -1;
+				for (k = 0; k <= K + 2 * g.boundary; k++) {
+					b.offset = k <= K ? offsets[k] : (k == K + 1 ? left : right);
+					b.len = k <= K ? g.outer * g.inner << k : g.outer * g.inner;
+					b.owner = owner(b.offset);
+					if (b.owner != rank) {
+						requests[b.owner].push_back(b.offset);
+						requests[b.owner].push_back(b.len);
+						fcounts[b.owner] += b.len;
+					}
+					blocks.push_back(b);
+				}
+				groups.push_back(g);
+			} while (more);
+		}
+	}
+
+	/* send the (offset, length) requests to the owners */
+	for (o = 0, i = 0; o < ranks; o++) {
+		scounts[o] = requests[o].size();
+		sdispls[o] = i;
+		i += scounts[o];
+	}
+	sbuf.resize(i + 1);
+	for (o = 0; o < ranks; o++)
+		std::copy(requests[o].begin(), requests[o].end(), sbuf.begin() + sdispls[o]);
+	MPI_Alltoall(&scounts[0], 1, MPI_INT, &rcounts[0], 1, MPI_INT, comm);
+	for (o = 0, i = 0; o < ranks; o++) {
+		rdispls[o] = i;
+		i += rcounts[o];
+	}
+	rbuf.resize(i + 1);
+	MPI_Alltoallv(&sbuf[0], &scounts[0], &sdispls[0], MPI_INT, &rbuf[0], &rcounts[0], &rdispls[0], MPI_INT, comm);
+
+	/* answer the requests of the other ranks with the local values */
+	for (o = 0; o < ranks; o++) {
+		gdispls[o] = reply.size();
+		for (i = rdispls[o]; i < rdispls[o] + rcounts[o]; i += 2)
+			reply.insert(reply.end(), sg1d + rbuf[i] - begin, sg1d + rbuf[i] - begin + rbuf[i + 1]);
+		gcounts[o] = reply.size() - gdispls[o];
+	}
+	for (o = 0, i = 0; o < ranks; o++) {
+		fdispls[o] = i;
+		i += fcounts[o];
+	}
+	ghost.resize(i + 1);
+	reply.resize(reply.size() + 1);
+	MPI_Alltoallv(&reply[0], &gcounts[0], &gdispls[0], MPI_FLOAT, &ghost[0], &fcounts[0], &fdispls[0], MPI_FLOAT, comm);
+
+	/* the values of the remote blocks arrive in the order they were requested */
+	for (j = 0; j < groups.size(); j++) {
+		poles.resize(groups[j].K + 3);
+		for (k = 0; k <= groups[j].K + 2 * groups[j].boundary; k++) {
+			b = blocks[groups[j].first + k];
+			if (b.owner == rank) {
+				data = sg1d + b.offset - begin;
+			} else {
+				data = &ghost[fdispls[b.owner]];
+				fdispls[b.owner] += b.len;
+			}
+			poles[k] = data;
+		}
+		Helper::hierarchize_poles(&poles[0], groups[j].K,
+				groups[j].boundary ? poles[groups[j].K + 1] : NULL,
+				groups[j].boundary ? poles[groups[j].K + 2] : NULL,
+				groups[j].outer, groups[j].inner, type);
+	}
+
+	return 0;
+}
+
+int DistributedSparseGrid::owner(int index)
+{
+	return std::upper_bound(ranges.begin(), ranges.end(), index) - ranges.begin() - 1;
+}
+
+float *DistributedSparseGrid::getLocal(int *begin, int *end)
+{
+	*begin = this->begin;
+	*end = this->end;
+
+	return sg1d;
+}
+
+/* returns the size of the sparse grid */
+int DistributedSparseGrid::size() const
+{
+	return numOfGridPoints;
+}
+
+/* returns the number of dimensions */
+int DistributedSparseGrid::getD()
+{
+	return d;
+}
+
+/* returns the refinement level */
+int DistributedSparseGrid::getL()
+{
+	return l;
+}
+
+/* returns the kind of the sparse grid */
+GridType DistributedSparseGrid::getType()
+{
+	return type;
+}
@@ -0,0 +1,149 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2009, 2010 Alin Murarasu
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+#include <mpi.h>
+
+#include <vector>
+
+#include "Function.h"
+#include "SparseGrid.h"
+
+#ifndef DISTRIBUTEDSPARSEGRID_H_
+#define DISTRIBUTEDSPARSEGRID_H_
+
+namespace fsg
+{
+	/**
+	* @class DistributedSparseGrid
+	*
+	* @brief Sparse grid partitioned across the ranks of an MPI communicator
+	*
+	* sg1d is split into one contiguous index range per rank; the ranges start and end at subspace
+	* boundaries, so every regular grid is owned by exactly one rank. All methods are collective.
+	*
+	* This class needs MPI and is therefore not part of libfastsg; compile DistributedSparseGrid.cpp
+	* with the MPI compiler wrapper and link it with the library (see make mpi-check).
+	*
+	* Note: for all methods available it's up to the user to make sure he is in the [0,1]^d domain
+	*
+	*/
+	class DistributedSparseGrid
+	{
+		public:
+			/**
+			 * Class constructor; every rank samples f on its own part of the grid
+			 * @param l Level of refinement
+			 * @param f Function to be represented using the sparse grid technique
+			 * @param comm The ranks sharing the grid
+			 * @param type GRID_BOUNDARY or GRID_ZERO_BOUNDARY (GRID_MODIFIED is not supported)
+			 */
+			DistributedSparseGrid(int l, Function* f, MPI_Comm comm, GridType type = GRID_BOUNDARY);
+
+			/**
+			 * Class destructor
+			 */
+			virtual ~DistributedSparseGrid();
+
+			/**
+			 * @param coords The point at which we evaluate (interpolate) the sparse grid, the same on all ranks
+			 * @return The result of the evaluation, on all ranks
+			 */
+			float evaluate(float *coords);
+
+			/**
+			 * @param coords The set of points at which we evaluate (interpolate) the sparse grid, the same on all ranks
+			 * @param n The size of the set
+			 * @param vals The results of the evaluation, on all ranks
+			 * Every rank evaluates its own subspaces; the partial sums are added up with MPI_Allreduce
+			 * @return Returns 0 if successfull
+			 */
+			int evaluate(float *coords, int n, float *vals);
+
+			/**
+			 * Computes the hierarchical coefficients. Before each dimension sweep the ranks exchange the
+			 * coefficients of the parents they do not own (one MPI_Alltoallv for the requests, one for the values)
+			 * @return Returns 0 if successful
+			 */
+			int hierarchize();
+
+			/**
+			 * @param begin Receives the position of the first coefficient owned by this rank
+			 * @param end Receives the position after the last coefficient owned by this rank
+			 * @return A pointer to the coefficients owned by this rank
+			 */
+			float *getLocal(int *begin, int *end);
+
+			/**
+			 * The number of grid points composing the (whole) sparse grid
+			 * @return The size of the sparse grid
+			 */
+			int size() const;
+
+			/**
+			 * The number of dimensions of the sparse grid
+			 * @return The dimensionality of the sparse grid
+			 */
+			int getD();
+
+			/**
+			 * The refinement level of the sparse grid
+			 * @return The refinement level of the sparse grid
+			 */
+			int getL();
+
+			/**
+			 * The kind of the sparse grid
+			 * @return GRID_BOUNDARY or GRID_ZERO_BOUNDARY
+			 */
+			GridType getType();
+
+		private:
+			DistributedSparseGrid(const DistributedSparseGrid &);
+			DistributedSparseGrid &operator=(const DistributedSparseGrid &);
+
+			/**
+			 * Hierarchizes the local coefficients in dimension cd
+			 * @return Returns 0 if successful
+			 */
+			int hierarchize(int cd);
+
+			/**
+			 * @param index Position of a coefficient
+			 * @return The rank that owns it
+			 */
+			int owner(int index);
+
+			MPI_Comm comm;
+			int rank, ranks;
+			std::vector<int> ranges;
+			float *sg1d;
+			int begin, end;
+			int numOfGridPoints;
+			int d, l;
+			GridType type;
+	};
+}
+
+#endif /* DISTRIBUTEDSPARSEGRID_H_ */
@@ -0,0 +1,297 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2009, 2010 Alin Murarasu
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+#include "EvaluationService.h"
+#include "Instrumentation.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <iostream>
+
+using namespace fsg;
+
+EvaluationService::EvaluationService(SparseGrid *grid, int workers, int maxBatch, long flushMicros, int capacity)
+{
+	this->grid = grid;
+	vgrid = NULL;
+	d = grid->getD();
+	start(workers, maxBatch, flushMicros, capacity);
+}
+
+EvaluationService::EvaluationService(VersionedSparseGrid *grid, int d, int workers, int maxBatch, long flushMicros,
+		int capacity)
+{
+	this->grid = NULL;
+	vgrid = grid;
+	this->d = d;
+	start(workers, maxBatch, flushMicros, capacity);
+}
+
+void EvaluationService::start(int workers, int maxBatch, long flushMicros, int capacity)
+{
+	unsigned long i, size = 1;
+	int t;
+
+	while (size < (unsigned long) capacity)
+		size <<= 1;
+	mask = size - 1;
+	this->maxBatch = maxBatch < 1 ? 1 : maxBatch;
+	flushNanos = flushMicros * 1000;
+
+	cells = new cell_t[size];
+	cellCoords = (float *) malloc((size * d + 1) * sizeof(float));
+	for (i = 0; i < size; i++)
+		cells[i].seq.store(i, std::memory_order_relaxed);
+	head.store(0);
+	tail.store(0);
+	running.store(1);
+	sleepers.store(0);
+	collecting = 0;
+	queries.store(0);
+	batches.store(0);
+
+	for (t = 0; t < (workers < 1 ? 1 : workers); t++)
+		threads.push_back(std::thread(&EvaluationService::work, this));
+}
+
+EvaluationService::~EvaluationService()
+{
+	size_t t;
+
+	running.store(0);
+	{
+		std::lock_guard<std::mutex> guard(idle);
+		wakeup.notify_all();
+		arrival.notify_all();
+	}
+	for (t = 0; t < threads.size(); t++)
+		threads[t].join();
+
+	delete[] cells;
+	free(cellCoords);
+}
+
+/* bounded multi-producer multi-consumer queue: a cell is free for position pos when its seq is pos */
+int EvaluationService::enqueue(float *coords, std::promise<float> *promise, eval_callback_t callback, void *arg)
+{
+	unsigned long pos = tail.load(std::memory_order_relaxed), seq;
+	cell_t *c;
+	long dif;
+
+	for (;;) {
+		c = &cells[pos & mask];
+		seq = c->seq.load(std::memory_order_acquire);
+		dif = (long) seq - (long) pos;
+		if (dif == 0) {
+			if (tail.compare_exchange_weak(pos, pos + 1))
+				break;
+		} else if (dif < 0) {
+			return -1;
+		} else {
+			pos = tail.load(std::memory_order_relaxed);
+		}
+	}
+
+	memcpy(cellCoords + (pos & mask) * d, coords, d * sizeof(float));
+	c->promise = promise;
+	c->callback = callback;
+	c->arg = arg;
+	c->stamp = Instrumentation::nanoseconds();
+	c->seq.store(pos + 1, std::memory_order_release);
+
+	/* wake up a worker only if one is waiting; the worker checks the queue again after announcing itself */
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (sleepers.load() > 0) {
+		std::lock_guard<std::mutex> guard(idle);
+		if (collecting)
+			arrival.notify_one();
+		else
+			wakeup.notify_one();
+	}
+
+	return 0;
+}
+
+/* a cell holds the query of position pos when its seq is pos + 1 */
+int EvaluationService::dequeue(float *coords, std::promise<float> **promise, eval_callback_t *callback, void **arg,
+		long *stamp)
+{
+	unsigned long pos = head.load(std::memory_order_relaxed), seq;
+	cell_t *c;
+	long dif;
+
+	for (;;) {
+		c = &cells[pos & mask];
+		seq = c->seq.load(std::memory_order_acquire);
+		dif = (long) seq - (long) (pos + 1);
+		if (dif == 0) {
+			if (head.compare_exchange_weak(pos, pos + 1))
+				break;
+		} else if (dif < 0) {
+			return -1;
+		} else {
+			pos = head.load(std::memory_order_relaxed);
+		}
+	}
+
+	memcpy(coords, cellCoords + (pos & mask) * d, d * sizeof(float));
+	*promise = c->promise;
+	*callback = c->callback;
+	*arg = c->arg;
+	*stamp = c->stamp;
+	c->seq.store(pos + mask + 1, std::memory_order_release);
+
+	return 0;
+}
+
+int EvaluationService::evaluate(float *coords, int n, float *vals)
+{
+	if (vgrid != NULL)
+		return vgrid->evaluate(coords, n, vals);
+
+	return grid->evaluate(coords, n, vals);
+}
+
+/* 1 if the query at the head of the queue is ready to be taken */
+int EvaluationService::queued()
+{
+	unsigned long pos = head.load();
+
+	return cells[pos & mask].seq.load(std::memory_order_acquire) == pos + 1;
+}
+
+void EvaluationService::work()
+{
+	std::vector<float> coords(maxBatch * d + 1), vals(maxBatch);
+	std::vector<std::promise<float> *> promises(maxBatch);
+	std::vector<eval_callback_t> callbacks(maxBatch);
+	std::vector<void *> args(maxBatch);
+	std::chrono::steady_clock::time_point until;
+	long stamp;
+	int n, j, ready;
+
+	for (;;) {
+		/* one worker collects a batch, the others sleep until it hands the collection over */
+		{
+			std::unique_lock<std::mutex> lock(idle);
+
+			sleepers++;
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			wakeup.wait(lock, [this]() { return !running.load() || (!collecting && queued()); });
+			sleepers--;
+			/* stopping: the queries left are taken by the worker collecting them */
+			if (collecting || !queued())
+				break;
+			collecting = 1;
+		}
+
+		/* fill the batch until it is full or the oldest query has waited long enough */
+		n = 0;
+		until = std::chrono::steady_clock::now();
+		while (n < maxBatch) {
+			if (!dequeue(&coords[n * d], &promises[n], &callbacks[n], &args[n], &stamp)) {
+				if (n++ == 0)
+					until = std::chrono::steady_clock::now()
+						+ std::chrono::nanoseconds(stamp + flushNanos - (long) Instrumentation::nanoseconds());
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(idle);
+
+			sleepers++;
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			ready = arrival.wait_until(lock, until, [this]() { return !running.load() || queued(); });
+			sleepers--;
+			if (!ready || !queued())
+				break;
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(idle);
+			collecting = 0;
+			wakeup.notify_one();
+		}
+
+		/* counted first, so that the stats include every query whose result is available */
+		evaluate(&coords[0], n, &vals[0]);
+		queries += n;
+		batches++;
+		for (j = 0; j < n; j++) {
+			if (promises[j] != NULL) {
+				promises[j]->set_value(vals[j]);
+				delete promises[j];
+			} else {
+				callbacks[j](vals[j], args[j]);
+			}
+		}
+	}
+}
+
+/* returns 0 if the point is inside the [0, 1]^d domain */
+static int check_domain(float *coords, int d)
+{
+	int i;
+
+	for (i = 0; i < d; i++)
+		if (coords[i] > 1 || coords[i] < 0) {
+			std::cout << "The coordinates are not in [0,1]^d domain" << std::endl;
+			return -1;
+		}
+
+	return 0;
+}
+
+std::future<float> EvaluationService::submit(float *coords)
+{
+	std::promise<float> *promise = new std::promise<float>();
+	std::future<float> result = promise->get_future();
+	float val = 0.0f;
+	int inside = !check_domain(coords, d);
+
+	if (!inside || enqueue(coords, promise, NULL, NULL)) {
+		/* invalid point or queue full: answer right away */
+		if (inside)
+			evaluate(coords, 1, &val);
+		promise->set_value(val);
+		delete promise;
+	}
+
+	return result;
+}
+
+int EvaluationService::submit(float *coords, eval_callback_t callback, void *arg)
+{
+	if (check_domain(coords, d))
+		return -1;
+
+	return enqueue(coords, NULL, callback, arg);
+}
+
+void EvaluationService::getStats(long *queries, long *batches)
+{
+	*queries = this->queries.load();
+	*batches = this->batches.load();
+}
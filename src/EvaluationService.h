@@ -0,0 +1,138 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2009, 2010 Alin Murarasu
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+#ifndef EVALUATIONSERVICE_H_
+#define EVALUATIONSERVICE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "SparseGrid.h"
+#include "VersionedSparseGrid.h"
+
+namespace fsg
+{
+	/* completion of a query submitted with a callback; called on a worker thread */
+	typedef void (*eval_callback_t)(float val, void *arg);
+
+	/**
+	 * @class EvaluationService
+	 *
+	 * @brief Evaluates single-point queries from many threads in batches
+	 *
+	 * Queries go into a bounded lock-free queue (multi-producer, multi-consumer). One worker at a time collects
+	 * a batch: it sleeps on a condition variable between queries until it has maxBatch of them or the oldest
+	 * one has waited flushMicros, then hands the collection over and runs the batch evaluation, completing the
+	 * futures / calling the callbacks. The other workers block until it is their turn. A query therefore waits
+	 * at most about flushMicros plus one batch evaluation before it is processed.
+	 *
+	 */
+	class EvaluationService
+	{
+		public:
+			/**
+			 * Class constructor; starts the workers
+			 * @param grid The grid to evaluate (hierarchized; it must outlive the service)
+			 * @param workers Number of worker threads
+			 * @param maxBatch Largest batch
+			 * @param flushMicros Longest time a query waits for the batch to fill up, in microseconds
+			 * @param capacity Size of the queue (rounded up to a power of 2)
+			 */
+			EvaluationService(SparseGrid *grid, int workers, int maxBatch, long flushMicros, int capacity = 4096);
+
+			/**
+			 * Class constructor; every batch is evaluated against a single version of grid
+			 */
+			EvaluationService(VersionedSparseGrid *grid, int d, int workers, int maxBatch, long flushMicros,
+					int capacity = 4096);
+
+			/**
+			 * Class destructor; the queued queries are completed before the workers stop
+			 */
+			virtual ~EvaluationService();
+
+			/**
+			 * @param coords The point (copied, so it may be reused as soon as the call returns)
+			 * @return The result of the evaluation; if the queue is full the query is evaluated by the caller
+			 */
+			std::future<float> submit(float *coords);
+
+			/**
+			 * @param coords The point (copied)
+			 * @param callback Receives the result, on a worker thread
+			 * @param arg Passed to callback
+			 * @return Returns 0 if the query was queued, -1 if the queue is full (callback is not called)
+			 */
+			int submit(float *coords, eval_callback_t callback, void *arg);
+
+			/**
+			 * @param queries Receives the number of queries evaluated so far
+			 * @param batches Receives the number of batches they were evaluated in
+			 */
+			void getStats(long *queries, long *batches);
+
+		private:
+			EvaluationService(const EvaluationService &);
+			EvaluationService &operator=(const EvaluationService &);
+
+			void start(int workers, int maxBatch, long flushMicros, int capacity);
+			int enqueue(float *coords, std::promise<float> *promise, eval_callback_t callback, void *arg);
+			int dequeue(float *coords, std::promise<float> **promise, eval_callback_t *callback, void **arg, long *stamp);
+			void work();
+			int queued();
+			int evaluate(float *coords, int n, float *vals);
+
+			/* one query; seq implements the bounded MPMC queue protocol */
+			typedef struct cell_t {
+				std::atomic<unsigned long> seq;
+				std::promise<float> *promise;
+				eval_callback_t callback;
+				void *arg;
+				long stamp;
+			} cell_t;
+
+			SparseGrid *grid;
+			VersionedSparseGrid *vgrid;
+			int d, maxBatch;
+			long flushNanos;
+			cell_t *cells;
+			float *cellCoords;
+			unsigned long mask;
+			std::atomic<unsigned long> head, tail;
+			std::atomic<int> running, sleepers;
+			std::atomic<long> queries, batches;
+			std::mutex idle;
+			int collecting;				/* a worker is collecting a batch; guarded by idle */
+			std::condition_variable wakeup;		/* idle workers, waiting to collect */
+			std::condition_variable arrival;	/* the collecting worker, waiting for the next query */
+			std::vector<std::thread> threads;
+	};
+}
+
+#endif /* EVALUATIONSERVICE_H_ */
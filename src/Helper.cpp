@@ -23,9 +23,14 @@
  *
  *********************************************************************************/
 
+#include <string.h>
 #include <iostream>
+#include <vector>
+#include <algorithm>
 
 #include "Helper.h"
+#include "Kernels.h"
+#include "Layout.h"
 
 #include "Converter.h"
 
@@ -34,28 +39,12 @@ using namespace fsg;
 /* returns the number of grid points of a 0-boundary sparse grid, d-dimensional, level of refinement n */
 int Helper::zerob_size(int d, int n)
 {
-	int j;
-	int s0b = 0;
-
-	if (d == 0)
-		return 1;
-
-	for (j = 0; j < n; j++)
-		s0b += (1 << j) * combi(d - 1 + j, j);
-
-	return s0b;
+	return layout_zerob_size<int>(d, n);
 }
 
 int Helper::combi(int n, int k)
 {
-	int i, c = 1;
-
-	for (i = k + 1; i <= n; i++) {
-		c *= i;
-		c /= i - k;
-	}
-
-	return c;
+	return layout_combi<int>(n, k);
 }
 
 int Helper::generate_grid_points(sparse_grid_t sg, float* gp, int crt_d, int n, Function* f)
@@ -90,3 +79,172 @@ int Helper::generate_grid_points(sparse_grid_t sg, float* gp, int crt_d, int n,
 
 	return count;
 }
+
+int Helper::next_levels(int *levels, int n, int max)
+{
+	int i, sum = 0;
+
+	for (i = 0; i < n; i++)
+		sum += levels[i];
+
+	/* odometer: increment the last component that still fits, reset the ones after it */
+	for (i = n - 1; i >= 0; i--) {
+		if (sum < max) {
+			levels[i]++;
+			return 1;
+		}
+		sum -= levels[i];
+		levels[i] = 0;
+	}
+
+	return 0;
+}
+
+void Helper::hierarchize_poles(float **blocks, int K, float *left, float *right, int outer, int inner, GridType type)
+{
+	Kernels::hierarchize_poles(blocks, K, left, right, outer, inner, type, 0);
+}
+
+int Helper::pole_group(int *levels, int *indices, int base, int cd, int *lp, int d, int n, GridType type,
+		int *offsets, int *left, int *right, int *outer, int *inner)
+{
+	return layout_pole_group<int>(levels, indices, base, cd, lp, d, n, type, offsets, left, right, outer, inner);
+}
+
+int Helper::evaluate_range(float *coefs, int begin, int end, int d, int n, GridType type,
+		float *coords, int num, float *vals)
+{
+	int k, i, j, index1, t0, pd, kk, zsize, pos;
+	int indices[d], plevels[d], levels[d];
+	std::vector<float> prod0s(num), prods(num + 1), pcoords((long) num * d + 1);
+	std::vector<int> index(num + 1);
+
+	index1 = 0;
+
+	for (pd = d; pd >= (type != GRID_BOUNDARY ? d : 0); pd--) {
+		zsize = zerob_size(pd, n);
+		for (kk = 0; kk < (1 << (d - pd)) * combi(d, d - pd); kk++, index1 += zsize) {
+			/* skip the sparse grids outside the range */
+			if (index1 + zsize <= begin || index1 >= end)
+				continue;
+
+			Converter::idx2gp(index1, levels, indices, d, n);
+			for (j = 0; j < num; j++) {
+				prod0s[j] = 1.0f;
+				i = 0;
+				for (k = 0; k < d; k++) {
+					if (levels[k] == -1) {
+						if (indices[k] == 0)
+							prod0s[j] *= (1 - coords[(long) j * d + k]);
+						else
+							prod0s[j] *= coords[(long) j * d + k];
+					} else {
+						pcoords[(long) i++ * num + j] = coords[(long) j * d + k];
+					}
+				}
+			}
+
+			if (pd == 0) {
+				for (j = 0; j < num; j++)
+					vals[j] += prod0s[j] * coefs[index1 - begin];
+				continue;
+			}
+
+			memset(plevels, 0, pd * sizeof(int));
+			pos = index1;
+
+			for (i = 0; i < n; i++) {
+				plevels[0] = 0;
+				plevels[pd - 1] = i;
+				do {
+					if (pos >= begin && pos < end) {
+						std::copy(prod0s.begin(), prod0s.end(), prods.begin());
+						Kernels::hats(&pcoords[0], num, pd, plevels, type, &prods[0], &index[0]);
+						Kernels::gather(coefs + pos - begin, &index[0], &prods[0], num, vals);
+					}
+					pos += 1 << i;
+
+					if (plevels[0] == i)
+						break;
+
+					k = 1;
+					while (plevels[k] == 0)
+						k++;
+					plevels[k]--;
+					t0 = plevels[0];
+					plevels[0] = 0;
+					plevels[k - 1] = t0 + 1;
+				} while (1);
+			}
+		}
+	}
+
+	return 0;
+}
+
+int Helper::partition(int d, int n, GridType type, int parts, int *ranges)
+{
+	int pd, kk, s, c, r, zsize, pos, size;
+
+	size = type != GRID_BOUNDARY ? zerob_size(d, n) : SparseGrid::size(d, n);
+
+	/* range r starts at the first subspace at or after r * size / parts */
+	for (r = 0; r <= parts; r++)
+		ranges[r] = size;
+	ranges[0] = 0;
+	r = 1;
+	pos = 0;
+	for (pd = d; pd >= (type != GRID_BOUNDARY ? d : 0) && r < parts; pd--) {
+		zsize = zerob_size(pd, n);
+		for (kk = 0; kk < (1 << (d - pd)) * combi(d, d - pd) && r < parts; kk++) {
+			/* no range starts inside this sparse grid */
+			if (pos + zsize <= (long) r * size / parts) {
+				pos += zsize;
+				continue;
+			}
+			if (pd == 0) {
+				while (r < parts && pos >= (long) r * size / parts)
+					ranges[r++] = pos;
+				pos++;
+				continue;
+			}
+			for (s = 0; s < n; s++)
+				for (c = 0; c < combi(pd - 1 + s, s); c++) {
+					while (r < parts && pos >= (long) r * size / parts)
+						ranges[r++] = pos;
+					pos += 1 << s;
+				}
+		}
+	}
+
+	return 0;
+}
+
+/* the key interleaves the bits of the quantized coordinates, most significant bits first */
+int Helper::morton_order(float *coords, int n, int d, int *order)
+{
+	int bits, dims = d, i, j, b;
+	unsigned long long key;
+	unsigned q[64];
+	std::vector<std::pair<unsigned long long, int> > keys(n);
+
+	if (dims > 64)
+		dims = 64;
+	bits = dims > 0 ? std::min(16, 64 / dims) : 0;
+
+	for (j = 0; j < n; j++) {
+		for (i = 0; i < dims; i++)
+			q[i] = std::min((1u << bits) - 1, (unsigned) (std::max(0.0f, coords[(long) j * d + i]) * (1 << bits)));
+		key = 0;
+		for (b = bits - 1; b >= 0; b--)
+			for (i = 0; i < dims; i++)
+				key = key << 1 | ((q[i] >> b) & 1);
+		keys[j] = std::make_pair(key, j);
+	}
+
+	std::sort(keys.begin(), keys.end());
+	for (j = 0; j < n; j++)
+		order[j] = keys[j].second;
+
+	return 0;
+}
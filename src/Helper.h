@@ -23,8 +23,12 @@
  *
  *********************************************************************************/
 
+#include <math.h>
+#include <string.h>
+
 #include "DataStructure.h"
 #include "Function.h"
+#include "SparseGrid.h"
 
 #ifndef HELPER_H_
 #define HELPER_H_
@@ -66,6 +70,139 @@ namespace fsg
 			 * @return Number of points generated
 			 */
 			static int generate_grid_points(sparse_grid_t sg, float* gp, int crt_d, int n, Function* f);
+			/**
+			 * Advances levels to the next level vector (in lexicographic order) whose components sum up to at most max
+			 * @param levels The current level vector, starting with the 0 vector
+			 * @param n Size of the level vector
+			 * @param max Upper bound for the sum of the components
+			 * @return 1 if levels contains the next vector, 0 if the enumeration is complete
+			 */
+			static int next_levels(int *levels, int n, int max);
+			/**
+			 * Hierarchizes in one dimension all poles of a pole group, i.e. of the subspaces that differ only in the
+			 * level k of that dimension. The subspace of level k is stored as outer x 2^k x inner (row-major), so each
+			 * update (child -= (left + right) / 2) is applied to a contiguous row of inner values at once: the inner
+			 * poles have the same structure and advance in lock-step, in the vector registers (see Kernels). In the
+			 * last dimension, where inner is 1, the outer poles advance in lock-step instead.
+			 * @param blocks The coefficients of the subspaces with level 0..K in the hierarchized dimension
+			 * @param K Highest level of the group in the hierarchized dimension
+			 * @param left Values of the left boundary (outer x inner), NULL if they are 0
+			 * @param right Values of the right boundary (outer x inner), NULL if they are 0
+			 * @param outer Number of points spanned by the dimensions preceding the hierarchized one
+			 * @param inner Number of points spanned by the dimensions following the hierarchized one
+			 * @param type GRID_MODIFIED selects the parents of the modified basis next to the boundary
+			 */
+			static void hierarchize_poles(float **blocks, int K, float *left, float *right, int outer, int inner,
+					GridType type);
+			/**
+			 * Locates the subspaces of a pole group of a 0-boundary sparse grid (see hierarchize_poles)
+			 * @param levels The l vector of the first point of the 0-boundary sparse grid
+			 * @param indices The i vector of the first point of the 0-boundary sparse grid
+			 * @param base Position of the first point of the 0-boundary sparse grid
+			 * @param cd The hierarchized dimension (interior in this sparse grid)
+			 * @param lp Levels of the group in the other interior dimensions, as enumerated by next_levels
+			 * @param d Number of dimensions
+			 * @param n Level of refinement
+			 * @param type GRID_BOUNDARY, GRID_ZERO_BOUNDARY or GRID_MODIFIED
+			 * @param offsets Receives the positions of the subspaces with level 0..K in dimension cd
+			 * @param left Receives the position of the left boundary values (-1 if they are 0)
+			 * @param right Receives the position of the right boundary values (-1 if they are 0)
+			 * @param outer Receives the outer size of the group (see hierarchize_poles)
+			 * @param inner Receives the inner size of the group (see hierarchize_poles)
+			 * @return K, the highest level of the group in dimension cd
+			 */
+			static int pole_group(int *levels, int *indices, int base, int cd, int *lp, int d, int n, GridType type,
+					int *offsets, int *left, int *right, int *outer, int *inner);
+			/**
+			 * Evaluates the part of a sparse grid stored in the index range [begin, end); both ends must be
+			 * subspace boundaries. The contributions are added to vals.
+			 * @param coefs The hierarchical coefficients begin .. end - 1
+			 * @param begin Position of the first coefficient
+			 * @param end Position after the last coefficient
+			 * @param d Number of dimensions
+			 * @param n Level of refinement
+			 * @param type GRID_BOUNDARY, GRID_ZERO_BOUNDARY or GRID_MODIFIED
+			 * @param coords The points (num x d, row-major) inside the [0, 1]^d domain
+			 * @param num Number of points
+			 * @param vals The partial results, one per point
+			 * @return Returns 0 if successful
+			 */
+			static int evaluate_range(float *coefs, int begin, int end, int d, int n, GridType type,
+					float *coords, int num, float *vals);
+			/**
+			 * Splits a sparse grid into contiguous index ranges of about the same size that start and end at
+			 * subspace boundaries (range p is [ranges[p], ranges[p + 1]); ranges may be empty)
+			 * @param d Number of dimensions
+			 * @param n Level of refinement
+			 * @param type GRID_BOUNDARY, GRID_ZERO_BOUNDARY or GRID_MODIFIED
+			 * @param parts Number of ranges
+			 * @param ranges Receives the parts + 1 range limits
+			 * @return Returns 0 if successful
+			 */
+			static int partition(int d, int n, GridType type, int parts, int *ranges);
+			/**
+			 * Sorts a set of points along a Morton (Z-order) curve, so that points close to each other in [0, 1]^d
+			 * mostly follow each other (with more than 64 dimensions only the first 64 are used)
+			 * @param coords The points (n x d, row-major) inside the [0, 1]^d domain
+			 * @param n Number of points
+			 * @param d Number of dimensions
+			 * @param order Receives the numbers of the points, in curve order
+			 * @return Returns 0 if successful
+			 */
+			static int morton_order(float *coords, int n, int d, int *order);
+			/**
+			 * Decodes a dyadic coordinate x = (2 * index + 1) / 2^(level + 1) from the bits of the float.
+			 * x = m * 2^(e - 150) with m the 24-bit mantissa, so with t trailing zeros in m we get
+			 * level = 149 - e - t and index = m >> (t + 1). t is read from the exponent of the lowest set
+			 * bit of m converted to float, which keeps the code free of loops and branches.
+			 * @param x Coordinate in (0, 1)
+			 * @param level Receives the level
+			 * @param index Receives the index
+			 */
+			static inline void decode_dyadic(float x, int *level, int *index)
+			{
+				unsigned int bits, m, t, e;
+				float low;
+
+				memcpy(&bits, &x, sizeof(bits));
+				e = bits >> 23;
+				m = (bits & 0x7fffff) | 0x800000;
+				low = (float) (m & -m);
+				memcpy(&t, &low, sizeof(t));
+				t = (t >> 23) - 127;
+
+				*level = 149 - (int) e - (int) t;
+				*index = (int) (m >> (t + 1));
+			}
+
+			/**
+			 * Value at x of the modified linear basis function of a level whose support contains x: constant 1 on
+			 * level 0, the hat otherwise, except next to the boundary where it extrapolates linearly up to 2
+			 * @param x Coordinate in [0, 1]
+			 * @param level Level of the basis function
+			 * @param index The index within the subspace, updated with the cell of x (index * 2^level + cell)
+			 * @return The value of the basis function
+			 */
+			static inline float modified_basis(float x, int level, int *index)
+			{
+				int cells = 1 << level, cell = (int) (x * cells);
+				float m;
+
+				/* x = 1 belongs to the last cell */
+				if (cell == cells)
+					cell--;
+				m = 2.0f * (x * cells - cell) - 1.0f;
+				*index = *index * cells + cell;
+
+				if (level == 0)
+					return 1.0f;
+				if (cell == 0)
+					return 1.0f - m;
+				if (cell == cells - 1)
+					return 1.0f + m;
+
+				return 1.0f - fabsf(m);
+			}
 	};
 }
 
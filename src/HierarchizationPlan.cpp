@@ -0,0 +1,159 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2009, 2010 Alin Murarasu
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+#include "HierarchizationPlan.h"
+#include "Converter.h"
+#include "Helper.h"
+#include "Kernels.h"
+
+#include <iostream>
+#include <stdlib.h>
+
+using namespace fsg;
+
+HierarchizationPlan::HierarchizationPlan(int d, int l, GridType type)
+{
+	int i, cd, pd, kk, K, index1, zsize, left, right, outer, inner;
+	int levels[d + 1], indices[d + 1], lp[d + 1], offsets[l + 1];
+
+	this->d = 0;
+	this->l = 0;
+	this->type = type;
+	numOfGridPoints = 0;
+	scratchSize = 0;
+	starts.push_back(0);
+
+	try {
+		if (d < 0 || l < 0)
+			throw 1;
+	} catch (int e) {
+		std::cout
+				<< "Exception: number of dimensions and refinement level must be positive!"
+				<< std::endl;
+		return;
+	}
+
+	this->d = d;
+	this->l = l;
+	numOfGridPoints = type == GRID_BOUNDARY ? SparseGrid::size(d, l) : Helper::zerob_size(d, l);
+
+	starts.clear();
+	for (cd = 0; cd < d; cd++) {
+		starts.push_back(groups.size());
+		if (l == 0)
+			continue;
+
+		index1 = 0;
+		for (pd = d; pd >= (type != GRID_BOUNDARY ? d : 1); pd--) {
+			zsize = Helper::zerob_size(pd, l);
+			for (kk = 0; kk < (1 << (d - pd)) * Helper::combi(d, d - pd); kk++, index1 += zsize) {
+				Converter::idx2gp(index1, levels, indices, d, l);
+				if (levels[cd] == -1)
+					continue;
+
+				/* lp = levels of the group in the other interior dimensions */
+				for (i = 0; i < pd - 1; i++)
+					lp[i] = 0;
+				do {
+					K = Helper::pole_group(levels, indices, index1, cd, lp, d, l, type, offsets, &left, &right,
+							&outer, &inner);
+					groups.push_back(K);
+					groups.push_back(left);
+					groups.push_back(right);
+					groups.push_back(outer);
+					groups.push_back(inner);
+					groups.insert(groups.end(), offsets, offsets + K + 1);
+					if (Kernels::poles_scratch(K, outer, inner) > scratchSize)
+						scratchSize = Kernels::poles_scratch(K, outer, inner);
+				} while (pd > 1 && Helper::next_levels(lp, pd - 1, l - 1));
+			}
+		}
+	}
+	starts.push_back(groups.size());
+}
+
+HierarchizationPlan::~HierarchizationPlan()
+{
+}
+
+void HierarchizationPlan::apply(float *values, int cd, int inverse, float *scratch) const
+{
+	int g, k, K = 0;
+	float *blocks[l + 1];
+	const int *p;
+
+	for (g = starts[cd]; g < starts[cd + 1]; g += 6 + K) {
+		p = &groups[g];
+		K = p[0];
+		for (k = 0; k <= K; k++)
+			blocks[k] = values + p[5 + k];
+		Kernels::hierarchize_poles(blocks, K, p[1] == -1 ? NULL : values + p[1], p[2] == -1 ? NULL : values + p[2],
+				p[3], p[4], type, inverse, scratch);
+	}
+}
+
+int HierarchizationPlan::hierarchize(float *values) const
+{
+	int cd;
+	float *scratch = scratchSize ? (float *) malloc(scratchSize * sizeof(float)) : NULL;
+
+	for (cd = 0; cd < d; cd++)
+		apply(values, cd, 0, scratch);
+	free(scratch);
+
+	return 0;
+}
+
+int HierarchizationPlan::dehierarchize(float *values) const
+{
+	int cd;
+	float *scratch = scratchSize ? (float *) malloc(scratchSize * sizeof(float)) : NULL;
+
+	for (cd = d - 1; cd >= 0; cd--)
+		apply(values, cd, 1, scratch);
+	free(scratch);
+
+	return 0;
+}
+
+int HierarchizationPlan::size() const
+{
+	return numOfGridPoints;
+}
+
+int HierarchizationPlan::getD() const
+{
+	return d;
+}
+
+int HierarchizationPlan::getL() const
+{
+	return l;
+}
+
+GridType HierarchizationPlan::getType() const
+{
+	return type;
+}
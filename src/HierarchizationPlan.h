@@ -0,0 +1,117 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2009, 2010 Alin Murarasu
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+#include <vector>
+
+#include "SparseGrid.h"
+
+#ifndef HIERARCHIZATIONPLAN_H_
+#define HIERARCHIZATIONPLAN_H_
+
+namespace fsg
+{
+	/**
+	 * @class HierarchizationPlan
+	 *
+	 * @brief The pole schedule of the sparse grids of one shape, to (de)hierarchize many of them
+	 *
+	 * Built once per (d, l, type): for every dimension, the pole groups (see Helper::hierarchize_poles) with the
+	 * positions of their subspaces and boundary values. Applying the plan to a coefficient array runs only the
+	 * pole kernels; no position is converted (idx2gp, gp2idx) and no parent is searched.
+	 *
+	 */
+	class HierarchizationPlan
+	{
+		public:
+			/**
+			 * Class constructor
+			 * @param d Number of dimensions
+			 * @param l Level of refinement
+			 * @param type The kind of the sparse grids
+			 */
+			HierarchizationPlan(int d, int l, GridType type = GRID_BOUNDARY);
+
+			/**
+			 * Class destructor
+			 */
+			virtual ~HierarchizationPlan();
+
+			/**
+			 * Turns function values into hierarchical coefficients, in place
+			 * @param values The values of the grid points, in the layout of SparseGrid (size() of them)
+			 * @return Returns 0 if successful
+			 */
+			int hierarchize(float *values) const;
+
+			/**
+			 * Turns hierarchical coefficients back into function values, in place (the inverse of hierarchize)
+			 * @param values The coefficients of the grid points, in the layout of SparseGrid (size() of them)
+			 * @return Returns 0 if successful
+			 */
+			int dehierarchize(float *values) const;
+
+			/**
+			 * @return The number of grid points of the sparse grids
+			 */
+			int size() const;
+
+			/**
+			 * @return The number of dimensions
+			 */
+			int getD() const;
+
+			/**
+			 * @return The refinement level
+			 */
+			int getL() const;
+
+			/**
+			 * @return The kind of the sparse grids
+			 */
+			GridType getType() const;
+
+		private:
+			HierarchizationPlan(const HierarchizationPlan &);
+			HierarchizationPlan &operator=(const HierarchizationPlan &);
+
+			/**
+			 * Applies the groups of one dimension
+			 * @param scratch scratchSize floats for the transposed groups (see Kernels::poles_scratch), or NULL
+			 */
+			void apply(float *values, int cd, int inverse, float *scratch) const;
+
+			int d, l;
+			GridType type;
+			int numOfGridPoints;
+			/* the largest scratch of a group, allocated once per (de)hierarchization */
+			long scratchSize;
+			/* per group: K, left, right, outer, inner and the K + 1 subspace positions (left/right -1 if 0) */
+			std::vector<int> groups;
+			/* the groups of dimension cd start at groups[starts[cd]] */
+			std::vector<int> starts;
+	};
+}
+
+#endif /* HIERARCHIZATIONPLAN_H_ */
@@ -0,0 +1,197 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2009, 2010 Alin Murarasu
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+#include "Instrumentation.h"
+
+#include <string.h>
+#include <time.h>
+
+#include <atomic>
+#include <mutex>
+#include <set>
+
+using namespace fsg;
+
+/* the values of one thread; only the owning thread writes them, so no read-modify-write is needed */
+typedef struct inst_thread_t {
+	std::atomic<unsigned long long> counters[INST_NUM_COUNTERS];
+	std::atomic<unsigned long long> calls[INST_NUM_OPS];
+	std::atomic<unsigned long long> latency_ns[INST_NUM_OPS];
+	std::atomic<unsigned long long> histogram[INST_NUM_OPS][INST_HISTOGRAM_BUCKETS];
+} inst_thread_t;
+
+/* registry of the live threads plus the totals of the exited ones and the values at the last reset */
+typedef struct inst_registry_t {
+	std::mutex lock;
+	std::set<inst_thread_t *> threads;
+	inst_stats_t retired;
+	inst_stats_t base;
+} inst_registry_t;
+
+static inst_registry_t *registry()
+{
+	/* never destroyed, so threads exiting after main can still retire their counters */
+	static inst_registry_t *r = new inst_registry_t();
+
+	return r;
+}
+
+static void accumulate(inst_stats_t *s, inst_thread_t *t)
+{
+	int i, j;
+
+	for (i = 0; i < INST_NUM_COUNTERS; i++)
+		s->counters[i] += t->counters[i].load(std::memory_order_relaxed);
+	for (i = 0; i < INST_NUM_OPS; i++) {
+		s->calls[i] += t->calls[i].load(std::memory_order_relaxed);
+		s->latency_ns[i] += t->latency_ns[i].load(std::memory_order_relaxed);
+		for (j = 0; j < INST_HISTOGRAM_BUCKETS; j++)
+			s->histogram[i][j] += t->histogram[i][j].load(std::memory_order_relaxed);
+	}
+}
+
+/* sums retired and live counters; the registry lock must be held */
+static void total(inst_stats_t *s)
+{
+	inst_registry_t *r = registry();
+	std::set<inst_thread_t *>::iterator it;
+
+	memcpy(s, &r->retired, sizeof(inst_stats_t));
+	for (it = r->threads.begin(); it != r->threads.end(); ++it)
+		accumulate(s, *it);
+}
+
+class InstThreadSlot
+{
+	public:
+		inst_thread_t values;
+
+		InstThreadSlot()
+		{
+			inst_registry_t *r = registry();
+			int i, j;
+
+			for (i = 0; i < INST_NUM_COUNTERS; i++)
+				values.counters[i].store(0, std::memory_order_relaxed);
+			for (i = 0; i < INST_NUM_OPS; i++) {
+				values.calls[i].store(0, std::memory_order_relaxed);
+				values.latency_ns[i].store(0, std::memory_order_relaxed);
+				for (j = 0; j < INST_HISTOGRAM_BUCKETS; j++)
+					values.histogram[i][j].store(0, std::memory_order_relaxed);
+			}
+
+			std::lock_guard<std::mutex> guard(r->lock);
+			r->threads.insert(&values);
+		}
+
+		~InstThreadSlot()
+		{
+			inst_registry_t *r = registry();
+
+			std::lock_guard<std::mutex> guard(r->lock);
+			accumulate(&r->retired, &values);
+			r->threads.erase(&values);
+		}
+};
+
+static inst_thread_t *local()
+{
+	static thread_local InstThreadSlot slot;
+
+	return &slot.values;
+}
+
+static inline void bump(std::atomic<unsigned long long> &c, unsigned long long v)
+{
+	c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+}
+
+int Instrumentation::enabled()
+{
+#ifdef FSG_INSTRUMENT
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+int Instrumentation::snapshot(inst_stats_t *stats)
+{
+	inst_registry_t *r = registry();
+	int i, j;
+
+	memset(stats, 0, sizeof(inst_stats_t));
+	if (!enabled())
+		return -1;
+
+	std::lock_guard<std::mutex> guard(r->lock);
+	total(stats);
+
+	for (i = 0; i < INST_NUM_COUNTERS; i++)
+		stats->counters[i] -= r->base.counters[i];
+	for (i = 0; i < INST_NUM_OPS; i++) {
+		stats->calls[i] -= r->base.calls[i];
+		stats->latency_ns[i] -= r->base.latency_ns[i];
+		for (j = 0; j < INST_HISTOGRAM_BUCKETS; j++)
+			stats->histogram[i][j] -= r->base.histogram[i][j];
+	}
+
+	return 0;
+}
+
+void Instrumentation::reset()
+{
+	inst_registry_t *r = registry();
+
+	std::lock_guard<std::mutex> guard(r->lock);
+	total(&r->base);
+}
+
+void Instrumentation::add(int counter, unsigned long long v)
+{
+	bump(local()->counters[counter], v);
+}
+
+void Instrumentation::addLatency(int op, unsigned long long ns)
+{
+	inst_thread_t *t = local();
+	int b = 0;
+
+	while (b < INST_HISTOGRAM_BUCKETS - 1 && (ns >> (b + 1)))
+		b++;
+
+	bump(t->calls[op], 1);
+	bump(t->latency_ns[op], ns);
+	bump(t->histogram[op][b], 1);
+}
+
+unsigned long long Instrumentation::nanoseconds()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
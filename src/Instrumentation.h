@@ -0,0 +1,135 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2009, 2010 Alin Murarasu
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+#ifndef INSTRUMENTATION_H_
+#define INSTRUMENTATION_H_
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+ * The hot-path instrumentation is compiled in only if the library is built with
+ * -DFSG_INSTRUMENT (e.g. ./configure CPPFLAGS=-DFSG_INSTRUMENT). Otherwise FSG_INST
+ * expands to nothing and the evaluation/conversion routines are unchanged.
+ */
+#ifdef FSG_INSTRUMENT
+#define FSG_INST(...) __VA_ARGS__
+#else
+#define FSG_INST(...)
+#endif
+
+namespace fsg
+{
+	/* event counters */
+	enum {
+		INST_SUBSPACES = 0,	/* regular grids (subspaces) visited during evaluation */
+		INST_COEFFICIENTS,	/* hierarchical coefficients read during evaluation */
+		INST_CONVERSIONS,	/* Converter routines executed (nested calls included) */
+		INST_CYCLES_SETUP,	/* cycles spent converting the sparse grid start (idx2gp) and computing the boundary product */
+		INST_CYCLES_HATS,	/* cycles spent computing products of 1d hat functions */
+		INST_CYCLES_GATHER,	/* cycles spent loading and accumulating the coefficients */
+		INST_NUM_COUNTERS
+	};
+
+	/* operations for which latency histograms are kept */
+	enum {
+		INST_OP_EVALUATE = 0,	/* single point evaluation */
+		INST_OP_EVALUATE_BATCH,	/* batch evaluation (one sample per call) */
+		INST_OP_HIERARCHIZE,
+		INST_NUM_OPS
+	};
+
+	/* bucket b counts the calls whose latency is in [2^b, 2^(b+1)) ns */
+	enum { INST_HISTOGRAM_BUCKETS = 40 };
+
+	typedef struct inst_stats_t {
+		unsigned long long counters[INST_NUM_COUNTERS];
+		unsigned long long calls[INST_NUM_OPS];
+		unsigned long long latency_ns[INST_NUM_OPS];
+		unsigned long long histogram[INST_NUM_OPS][INST_HISTOGRAM_BUCKETS];
+	} inst_stats_t;
+
+	/**
+	 * @class Instrumentation
+	 *
+	 * @brief Counters, cycle accounting and latency histograms for the hot paths
+	 *
+	 * Every thread accumulates into its own counters, so recording an event is a plain
+	 * store. snapshot() sums the counters of all threads (including the ones that have
+	 * exited) since the last reset().
+	 *
+	 */
+	class Instrumentation
+	{
+		public:
+			/**
+			 * @return 1 if the library was built with FSG_INSTRUMENT, 0 otherwise
+			 */
+			static int enabled();
+
+			/**
+			 * @param stats Receives the counters accumulated by all threads since the last reset
+			 * @return Returns 0 if successful, -1 if the instrumentation is compiled out (stats is zeroed)
+			 */
+			static int snapshot(inst_stats_t *stats);
+
+			/**
+			 * Starts a new measurement interval; counting is not interrupted
+			 */
+			static void reset();
+
+			/**
+			 * @param counter One of the INST_* counters
+			 * @param v Value added to the counter of the calling thread
+			 */
+			static void add(int counter, unsigned long long v);
+
+			/**
+			 * @param op One of the INST_OP_* operations
+			 * @param ns Latency of one call, in nanoseconds
+			 */
+			static void addLatency(int op, unsigned long long ns);
+
+			/**
+			 * @return Time stamp counter (or nanoseconds where no such counter is available)
+			 */
+			static inline unsigned long long cycles()
+			{
+#if defined(__x86_64__) || defined(__i386__)
+				return __rdtsc();
+#else
+				return nanoseconds();
+#endif
+			}
+
+			/**
+			 * @return Monotonic time in nanoseconds
+			 */
+			static unsigned long long nanoseconds();
+	};
+}
+
+#endif /* INSTRUMENTATION_H_ */
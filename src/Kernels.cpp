@@ -0,0 +1,407 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2009, 2010 Alin Murarasu
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+#include "Kernels.h"
+#include "Helper.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <iostream>
+#include <atomic>
+
+using namespace fsg;
+
+#if defined(__GNUC__) && !defined(__clang__)
+/* at -O2 gcc vectorizes only the loops with a suitable known trip count; the kernels run on any length */
+#pragma GCC optimize ("tree-vectorize", "vect-cost-model=dynamic")
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FSG_MULTI_ISA
+#endif
+
+/*
+ * The bodies of the kernels. They are inlined into one wrapper per level, so the compiler vectorizes
+ * each copy for the instruction set of its wrapper.
+ */
+#define FSG_KERNEL static inline __attribute__((always_inline))
+
+FSG_KERNEL void hats_body(float *pcoords, int n, int pd, int *plevels, GridType type, float *prods, int *index)
+{
+	int j, k, c, cells, last;
+	float *x, t, m, h, fcells;
+
+	for (j = 0; j < n; j++)
+		index[j] = 0;
+
+	for (k = 0; k < pd; k++) {
+		x = pcoords + (long) k * n;
+		cells = 1 << plevels[k];
+		last = cells - 1;
+		fcells = (float) cells;
+
+		/* the modified basis is constant on level 0 */
+		if (type == GRID_MODIFIED && plevels[k] == 0)
+			continue;
+
+		/* x = 1 belongs to the last cell */
+		if (type == GRID_MODIFIED) {
+			for (j = 0; j < n; j++) {
+				t = x[j] * fcells;
+				c = (int) t;
+				c = c < last ? c : last;
+				m = 2.0f * (t - c) - 1.0f;
+				h = 1.0f - fabsf(m);
+				h = c == 0 ? 1.0f - m : h;
+				h = c == last ? 1.0f + m : h;
+				index[j] = index[j] * cells + c;
+				prods[j] *= h;
+			}
+		} else {
+			for (j = 0; j < n; j++) {
+				t = x[j] * fcells;
+				c = (int) t;
+				c = c < last ? c : last;
+				m = 2.0f * (t - c) - 1.0f;
+				index[j] = index[j] * cells + c;
+				prods[j] *= 1.0f - fabsf(m);
+			}
+		}
+	}
+}
+
+FSG_KERNEL void gather_body(float *coefs, int *index, float *prods, int n, float *vals)
+{
+	int j;
+
+	for (j = 0; j < n; j++)
+		vals[j] += prods[j] * coefs[index[j]];
+}
+
+/* child -= sign * (left + right) / 2; sign is -1 to undo the hierarchization */
+FSG_KERNEL void rows_body(float *__restrict__ child, float *__restrict__ left, float *__restrict__ right, int len,
+		float sign)
+{
+	int r;
+
+	if (left && right) {
+		for (r = 0; r < len; r++)
+			child[r] = child[r] - sign * (left[r] + right[r]) / 2.0f;
+	} else if (left) {
+		for (r = 0; r < len; r++)
+			child[r] = child[r] - sign * left[r] / 2.0f;
+	} else if (right) {
+		for (r = 0; r < len; r++)
+			child[r] = child[r] - sign * right[r] / 2.0f;
+	}
+}
+
+/* the rows next to the boundary of the modified basis: child -= 1.5 near - 0.5 far, or child -= near on level 1 */
+FSG_KERNEL void edge_body(float *__restrict__ child, float *__restrict__ near, float *__restrict__ far, int len,
+		float sign)
+{
+	int r;
+
+	if (far) {
+		for (r = 0; r < len; r++)
+			child[r] = child[r] - sign * (1.5f * near[r] - 0.5f * far[r]);
+	} else {
+		for (r = 0; r < len; r++)
+			child[r] = child[r] - sign * near[r];
+	}
+}
+
+/*
+ * All rows of a pole group (see Helper::hierarchize_poles). The inner values of a row belong to poles with the
+ * same structure, so every update is a vector operation over a contiguous row.
+ */
+FSG_KERNEL void pole_rows_body(float **blocks, int K, float *left, float *right, int outer, int inner, GridType type,
+		int inverse)
+{
+	int k, o, i, t, a, last;
+	float *child, *lp, *rp, sign = inverse ? -1.0f : 1.0f;
+
+	/* the parents (coarser levels) must hold nodal values when they are read: finest level first when
+	 hierarchizing, coarsest level first when adding the parents back */
+	for (k = inverse ? 0 : K; k >= 0 && k <= K; k += inverse ? 1 : -1) {
+		last = (1 << k) - 1;
+		for (o = 0; o < outer; o++)
+			for (i = 0; i <= last; i++) {
+				child = blocks[k] + ((long) o * (1 << k) + i) * inner;
+
+				/* the first and the last basis function of the modified basis extrapolate from the two coarser ones */
+				if (type == GRID_MODIFIED && k >= 1 && (i == 0 || i == last)) {
+					lp = blocks[k - 1] + ((long) o * (1 << (k - 1)) + (i == 0 ? 0 : (1 << (k - 1)) - 1)) * inner;
+					rp = k >= 2 ? blocks[k - 2] + ((long) o * (1 << (k - 2)) + (i == 0 ? 0 : (1 << (k - 2)) - 1)) * inner
+						: NULL;
+					edge_body(child, lp, rp, inner, sign);
+					continue;
+				}
+
+				/* left parent at i / 2^k: level k - t - 1 with t the trailing zeros of i, or the boundary */
+				if (i == 0) {
+					lp = left ? left + (long) o * inner : NULL;
+				} else {
+					t = __builtin_ctz(i);
+					a = k - t - 1;
+					lp = blocks[a] + ((long) o * (1 << a) + (i >> (t + 1))) * inner;
+				}
+
+				/* right parent at (i + 1) / 2^k */
+				if (i == last) {
+					rp = right ? right + (long) o * inner : NULL;
+				} else {
+					t = __builtin_ctz(i + 1);
+					a = k - t - 1;
+					rp = blocks[a] + ((long) o * (1 << a) + ((i + 1) >> (t + 1))) * inner;
+				}
+
+				rows_body(child, lp, rp, inner, sign);
+			}
+	}
+}
+
+/* the smallest outer size of a group of the last dimension that is transposed */
+#define TRANSPOSE_OUTER 8
+
+/*
+ * In the last dimension (inner 1) a row is a single value and the outer poles lie 2^k apart in the subspace of
+ * level k. The group is then transposed to 2^k x outer in scratch (allocated here if NULL), so that every update
+ * runs over the outer poles as a contiguous vector, and transposed back; the boundary values (outer x 1) already
+ * are such a row. Without memory for the transposition the rows are updated one value at a time.
+ */
+FSG_KERNEL void poles_body(float **blocks, int K, float *left, float *right, int outer, int inner, GridType type,
+		int inverse, float *scratch)
+{
+	int k, o, i, size;
+	float *buffer = scratch, *t, *tblocks[K + 1];
+
+	if (inner == 1 && outer >= TRANSPOSE_OUTER && buffer == NULL)
+		buffer = (float *) malloc(((long) outer << (K + 1)) * sizeof(float));
+	if (inner != 1 || outer < TRANSPOSE_OUTER || buffer == NULL) {
+		pole_rows_body(blocks, K, left, right, outer, inner, type, inverse);
+		return;
+	}
+
+	for (k = 0, t = buffer; k <= K; t += (long) outer << k, k++) {
+		tblocks[k] = t;
+		size = 1 << k;
+		for (o = 0; o < outer; o++)
+			for (i = 0; i < size; i++)
+				t[(long) i * outer + o] = blocks[k][(long) o * size + i];
+	}
+
+	pole_rows_body(tblocks, K, left, right, 1, outer, type, inverse);
+
+	for (k = 0; k <= K; k++) {
+		size = 1 << k;
+		for (o = 0; o < outer; o++)
+			for (i = 0; i < size; i++)
+				blocks[k][(long) o * size + i] = tblocks[k][(long) i * outer + o];
+	}
+	if (buffer != scratch)
+		free(buffer);
+}
+
+FSG_KERNEL void coord2li_body(float *coords, int num, int *levels, int *indices)
+{
+	int k, level, index;
+	float c;
+
+	for (k = 0; k < num; k++) {
+		c = coords[k];
+		Helper::decode_dyadic(c, &level, &index);
+		level = c == 0.0f ? -1 : level;
+		level = c == 1.0f ? -1 : level;
+		index = c == 0.0f ? 0 : index;
+		index = c == 1.0f ? 1 : index;
+		levels[k] = level;
+		indices[k] = index;
+	}
+}
+
+FSG_KERNEL void li2coord_body(int *levels, int *indices, int num, float *coords)
+{
+	int k, level, index;
+	unsigned int bits;
+	float scale;
+
+	for (k = 0; k < num; k++) {
+		level = levels[k];
+		index = indices[k];
+		/* 2^-(level + 1), built directly in the exponent field */
+		bits = (unsigned int) (126 - level) << 23;
+		memcpy(&scale, &bits, sizeof(scale));
+		/* on the boundary the scale is 1 and the numerator becomes the index (no branch, so it vectorizes) */
+		coords[k] = (2 * index + 1 - (level == -1 ? index + 1 : 0)) * scale;
+	}
+}
+
+typedef struct kernel_table_t {
+	void (*hats)(float *pcoords, int n, int pd, int *plevels, GridType type, float *prods, int *index);
+	void (*gather)(float *coefs, int *index, float *prods, int n, float *vals);
+	void (*poles)(float **blocks, int K, float *left, float *right, int outer, int inner, GridType type, int inverse,
+			float *scratch);
+	void (*coord2li)(float *coords, int num, int *levels, int *indices);
+	void (*li2coord)(int *levels, int *indices, int num, float *coords);
+} kernel_table_t;
+
+/* the wrappers of one level and their table */
+#define FSG_KERNEL_TABLE(NAME, TARGET) \
+	TARGET static void NAME##_hats(float *pcoords, int n, int pd, int *plevels, GridType type, float *prods, int *index) \
+	{ hats_body(pcoords, n, pd, plevels, type, prods, index); } \
+	TARGET static void NAME##_gather(float *coefs, int *index, float *prods, int n, float *vals) \
+	{ gather_body(coefs, index, prods, n, vals); } \
+	TARGET static void NAME##_poles(float **blocks, int K, float *left, float *right, int outer, int inner, \
+			GridType type, int inverse, float *scratch) \
+	{ poles_body(blocks, K, left, right, outer, inner, type, inverse, scratch); } \
+	TARGET static void NAME##_coord2li(float *coords, int num, int *levels, int *indices) \
+	{ coord2li_body(coords, num, levels, indices); } \
+	TARGET static void NAME##_li2coord(int *levels, int *indices, int num, float *coords) \
+	{ li2coord_body(levels, indices, num, coords); } \
+	static const kernel_table_t NAME##_table = { NAME##_hats, NAME##_gather, NAME##_poles, \
+		NAME##_coord2li, NAME##_li2coord };
+
+FSG_KERNEL_TABLE(scalar, )
+#ifdef FSG_MULTI_ISA
+FSG_KERNEL_TABLE(sse42, __attribute__((target("sse4.2"))))
+FSG_KERNEL_TABLE(avx2, __attribute__((target("avx2,fma"))))
+FSG_KERNEL_TABLE(avx512, __attribute__((target("avx512f,avx512vl,avx512bw,avx512dq,avx2,fma"))))
+
+static const kernel_table_t *tables[ISA_NUM_LEVELS] = { &scalar_table, &sse42_table, &avx2_table, &avx512_table };
+#else
+static const kernel_table_t *tables[ISA_NUM_LEVELS] = { &scalar_table, NULL, NULL, NULL };
+#endif
+
+static const char *names[ISA_NUM_LEVELS] = { "scalar", "sse4.2", "avx2", "avx512" };
+
+/* starts with the scalar kernels, so calls made before the selection below are safe */
+static std::atomic<int> current(ISA_SCALAR);
+
+/* picks the level when the library is loaded */
+static int select_level()
+{
+	const char *env = getenv("FSG_ISA");
+	int k, best = ISA_SCALAR;
+
+	for (k = ISA_NUM_LEVELS - 1; k > ISA_SCALAR; k--)
+		if (Kernels::supported((IsaLevel) k)) {
+			best = k;
+			break;
+		}
+
+	if (env != NULL) {
+		for (k = 0; k < ISA_NUM_LEVELS; k++)
+			if (!strcmp(env, names[k]))
+				break;
+		if (k < ISA_NUM_LEVELS && Kernels::supported((IsaLevel) k))
+			best = k;
+		else
+			std::cout << "FSG_ISA=" << env << " is not supported, using " << names[best] << std::endl;
+	}
+
+	current = best;
+
+	return best;
+}
+
+static int selected = select_level();
+
+IsaLevel Kernels::level()
+{
+	return (IsaLevel) current.load(std::memory_order_relaxed);
+}
+
+int Kernels::select(IsaLevel level)
+{
+	if (!supported(level))
+		return -1;
+	current = level;
+
+	return 0;
+}
+
+int Kernels::supported(IsaLevel level)
+{
+	if (level < ISA_SCALAR || level >= ISA_NUM_LEVELS || tables[level] == NULL)
+		return 0;
+
+#ifdef FSG_MULTI_ISA
+	__builtin_cpu_init();
+	switch (level) {
+		case ISA_SSE42:
+			return __builtin_cpu_supports("sse4.2") != 0;
+		case ISA_AVX2:
+			return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+		case ISA_AVX512:
+			return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl")
+					&& __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq");
+		default:
+			break;
+	}
+#endif
+
+	return 1;
+}
+
+const char *Kernels::name(IsaLevel level)
+{
+	if (level < ISA_SCALAR || level >= ISA_NUM_LEVELS)
+		return "unknown";
+
+	return names[level];
+}
+
+void Kernels::hats(float *pcoords, int n, int pd, int *plevels, GridType type, float *prods, int *index)
+{
+	tables[current.load(std::memory_order_relaxed)]->hats(pcoords, n, pd, plevels, type, prods, index);
+}
+
+void Kernels::gather(float *coefs, int *index, float *prods, int n, float *vals)
+{
+	tables[current.load(std::memory_order_relaxed)]->gather(coefs, index, prods, n, vals);
+}
+
+void Kernels::hierarchize_poles(float **blocks, int K, float *left, float *right, int outer, int inner, GridType type,
+		int inverse, float *scratch)
+{
+	tables[current.load(std::memory_order_relaxed)]->poles(blocks, K, left, right, outer, inner, type, inverse, scratch);
+}
+
+long Kernels::poles_scratch(int K, int outer, int inner)
+{
+	return inner == 1 && outer >= TRANSPOSE_OUTER ? (long) outer << (K + 1) : 0;
+}
+
+void Kernels::coord2li(float *coords, int num, int *levels, int *indices)
+{
+	tables[current.load(std::memory_order_relaxed)]->coord2li(coords, num, levels, indices);
+}
+
+void Kernels::li2coord(int *levels, int *indices, int num, float *coords)
+{
+	tables[current.load(std::memory_order_relaxed)]->li2coord(levels, indices, num, coords);
+}
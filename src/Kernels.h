@@ -0,0 +1,121 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2009, 2010 Alin Murarasu
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+#include "SparseGrid.h"
+
+#ifndef KERNELS_H_
+#define KERNELS_H_
+
+namespace fsg
+{
+	/* instruction set levels the kernels are compiled for */
+	enum IsaLevel {
+		ISA_SCALAR = 0,	/* the flags the library is built with */
+		ISA_SSE42,	/* SSE4.2 */
+		ISA_AVX2,	/* AVX2 and FMA */
+		ISA_AVX512,	/* AVX-512 F, VL, BW and DQ */
+		ISA_NUM_LEVELS
+	};
+
+	/**
+	 * @class Kernels
+	 *
+	 * @brief The vectorizable inner loops, compiled once per instruction set level
+	 *
+	 * The level is chosen when the library is loaded: the best one the CPU supports (cpuid), unless the
+	 * environment variable FSG_ISA names another one (scalar, sse4.2, avx2 or avx512). Only the scalar
+	 * kernels exist on other architectures than x86.
+	 *
+	 */
+	class Kernels
+	{
+		public:
+			/**
+			 * @return The level in use
+			 */
+			static IsaLevel level();
+
+			/**
+			 * Switches all kernels to another level
+			 * @param level The level
+			 * @return Returns 0 if successful, -1 if the CPU (or the build) does not support it
+			 */
+			static int select(IsaLevel level);
+
+			/**
+			 * @param level A level
+			 * @return Returns 1 if the CPU and the build support the level
+			 */
+			static int supported(IsaLevel level);
+
+			/**
+			 * @param level A level
+			 * @return The name of the level, as used by FSG_ISA
+			 */
+			static const char *name(IsaLevel level);
+
+			/**
+			 * Multiplies the 1-dimensional basis functions of one subspace for a block of points
+			 * @param pcoords The coordinates in the interior dimensions, dimension by dimension (pd x n)
+			 * @param n The number of points
+			 * @param pd The number of interior dimensions
+			 * @param plevels The levels of the subspace
+			 * @param type The kind of the sparse grid (GRID_MODIFIED selects the modified basis)
+			 * @param prods Multiplied with the value of the basis function of each point
+			 * @param index Receives the position of the basis function of each point within the subspace
+			 */
+			static void hats(float *pcoords, int n, int pd, int *plevels, GridType type, float *prods, int *index);
+
+			/**
+			 * vals[j] += prods[j] * coefs[index[j]]
+			 */
+			static void gather(float *coefs, int *index, float *prods, int n, float *vals);
+
+			/**
+			 * Hierarchizes a pole group in one dimension, or undoes it if inverse is set; see Helper::hierarchize_poles.
+			 * A group of the last dimension (inner 1) is transposed, so that the updates are vectorized over outer.
+			 * @param scratch poles_scratch(K, outer, inner) floats for the transposition, NULL to allocate them
+			 */
+			static void hierarchize_poles(float **blocks, int K, float *left, float *right, int outer, int inner,
+					GridType type, int inverse, float *scratch = NULL);
+
+			/**
+			 * @return The number of floats of scratch hierarchize_poles needs for a group, 0 if it is not transposed
+			 */
+			static long poles_scratch(int K, int outer, int inner);
+
+			/**
+			 * Converts num coordinates to (level, index); see Converter::bulk_coord2li
+			 */
+			static void coord2li(float *coords, int num, int *levels, int *indices);
+
+			/**
+			 * Converts num (level, index) pairs to coordinates; see Converter::bulk_li2coord
+			 */
+			static void li2coord(int *levels, int *indices, int num, float *coords);
+	};
+}
+
+#endif /* KERNELS_H_ */
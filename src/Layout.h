@@ -0,0 +1,279 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2009, 2010 Alin Murarasu
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+#include <stdint.h>
+
+#include "SparseGrid.h"
+
+#ifndef LAYOUT_H_
+#define LAYOUT_H_
+
+namespace fsg
+{
+	/*
+	 * The layout of a sparse grid in memory (or in a file): the position of a grid point and the point at a
+	 * position. It is written once, for any integer type T of the positions (int in memory, int64_t in a file)
+	 * and any source of the binomial coefficients. A source L provides
+	 *   typedef ... index_t;			the type of the positions
+	 *   int d, n;				dimensions and level of the grid
+	 *   index_t combi(int a, int b);		a choose b, with the conventions of Helper::combi
+	 *   index_t zsize(int pd);			the size of a pd-dimensional 0-boundary sparse grid of level n
+	 *   index_t groupSize(int n01);		the size of all sparse grids with n01 boundary dimensions
+	 * DirectLayout computes them when needed; the bulk conversions look them up in tables.
+	 */
+
+	/* a choose b in T; 1 if b >= a, as the loop does not run */
+	template <typename T> static inline T layout_combi(int a, int b)
+	{
+		T c = 1;
+		int i;
+
+		for (i = b + 1; i <= a; i++) {
+			c *= i;
+			c /= i - b;
+		}
+
+		return c;
+	}
+
+	/* the number of points of a d-dimensional 0-boundary sparse grid of level n, in T */
+	template <typename T> static inline T layout_zerob_size(int d, int n)
+	{
+		T s = 0;
+		int j;
+
+		if (d == 0)
+			return 1;
+		for (j = 0; j < n; j++)
+			s += ((T) 1 << j) * layout_combi<T>(d - 1 + j, j);
+
+		return s;
+	}
+
+	/* the source of the binomial coefficients and sizes that computes them when needed */
+	template <typename T> class DirectLayout
+	{
+		public:
+			typedef T index_t;
+			int d, n;
+
+			DirectLayout(int d, int n) { this->d = d; this->n = n; }
+
+			T combi(int a, int b) const { return layout_combi<T>(a, b); }
+
+			T zsize(int pd) const { return layout_zerob_size<T>(pd, n); }
+
+			T groupSize(int n01) const { return ((T) 1 << n01) * combi(d, n01) * zsize(d - n01); }
+	};
+
+	/* the position of (levels, indices) in a d-dimensional 0-boundary sparse grid; only L::combi is used */
+	template <class L> static inline typename L::index_t layout_zb_gp2idx(const L &lay, int *levels, int *indices, int d)
+	{
+		typedef typename L::index_t T;
+		T index1, index2 = 0, index3 = 0;
+		int i, sum = 0;
+
+		index1 = indices[0];
+		for (i = 1; i < d; i++)
+			index1 = (index1 << levels[i]) + indices[i];
+
+		for (i = 0; i < d - 1; i++) {
+			sum += levels[i];
+			if (sum > 0)
+				index2 += lay.combi(i + sum, sum - 1);
+		}
+		sum += levels[i];
+		index2 <<= sum;
+		for (i = 0; i < sum; i++)
+			index3 += ((T) 1 << i) * lay.combi(d - 1 + i, i);
+
+		return index1 + index2 + index3;
+	}
+
+	/* the grid point at position index of a d-dimensional 0-boundary sparse grid; only L::combi is used */
+	template <class L> static inline void layout_zb_idx2gp(const L &lay, typename L::index_t index, int *levels,
+			int *indices, int d)
+	{
+		typedef typename L::index_t T;
+		T f = 1, isum = 0, rest;
+		int i = 0, j, sum, level;
+
+		while (index >= isum + lay.combi(d - 1 + i, i) * f) {
+			isum += lay.combi(d - 1 + i, i) * f;
+			f *= 2;
+			i++;
+		}
+
+		sum = i;
+		index -= isum;
+		rest = index & (((T) 1 << i) - 1);
+		index >>= i;
+
+		for (i = d - 2; i >= 0; i--) {
+			isum = 0;
+			j = 0;
+			while (index >= isum + lay.combi(i + j, j)) {
+				isum += lay.combi(i + j, j);
+				j++;
+			}
+			level = sum - j;
+			sum = j;
+			levels[i + 1] = level;
+			indices[i + 1] = (int) (rest & (((T) 1 << level) - 1));
+			rest >>= level;
+			index -= isum;
+		}
+
+		levels[0] = sum;
+		indices[0] = (int) (rest & (((T) 1 << sum) - 1));
+	}
+
+	/* the position of (levels, indices) in a non-0 boundary sparse grid of lay.d dimensions and level lay.n */
+	template <class L> static inline typename L::index_t layout_gp2idx(const L &lay, int *levels, int *indices)
+	{
+		typedef typename L::index_t T;
+		int d = lay.d, i, pd = 0, n01;
+		int plevels[d + 1], pindices[d + 1];
+		T index1, index2 = 0, index3 = 0;
+
+		/* the interior components make the position inside the 0-boundary sparse grid */
+		for (i = 0; i < d; i++)
+			if (levels[i] != -1) {
+				plevels[pd] = levels[i];
+				pindices[pd++] = indices[i];
+			}
+		index1 = pd ? layout_zb_gp2idx(lay, plevels, pindices, pd) : 0;
+
+		/* the boundary components select the sparse grid within its group */
+		n01 = d - pd;
+		for (i = 0; i < d; i++) {
+			if (levels[i] != -1) {
+				index2 += ((T) 1 << n01) * lay.combi(d - i - 1, n01 - 1);
+			} else {
+				n01--;
+				if (indices[i] == 1)
+					index2 += ((T) 1 << n01) * lay.combi(d - i - 1, n01);
+			}
+		}
+
+		/* the groups with less boundary dimensions come first */
+		for (i = 0; i < d - pd; i++)
+			index3 += lay.groupSize(i);
+
+		return index1 + index2 * lay.zsize(pd) + index3;
+	}
+
+	/* the grid point at position index of a non-0 boundary sparse grid of lay.d dimensions and level lay.n */
+	template <class L> static inline void layout_idx2gp(const L &lay, typename L::index_t index, int *levels,
+			int *indices)
+	{
+		typedef typename L::index_t T;
+		int d = lay.d, i, j = 0, n01 = 0, pd;
+		int plevels[d + 1], pindices[d + 1];
+		T index2;
+
+		/* n01 is the number of -1 components in levels */
+		while (index >= lay.groupSize(n01)) {
+			index -= lay.groupSize(n01);
+			n01++;
+		}
+		pd = d - n01;
+
+		/* the position inside the sparse grid and the number of the sparse grid inside its group */
+		layout_zb_idx2gp(lay, index % lay.zsize(pd), plevels, pindices, pd);
+		index2 = index / lay.zsize(pd);
+
+		for (i = 0; i < d; i++) {
+			if (index2 >= ((T) 1 << n01) * lay.combi(d - i - 1, n01 - 1)) {
+				levels[i] = plevels[j];
+				indices[i] = pindices[j++];
+				index2 -= ((T) 1 << n01) * lay.combi(d - i - 1, n01 - 1);
+			} else {
+				levels[i] = -1;
+				n01--;
+				if (index2 >= ((T) 1 << n01) * lay.combi(d - i - 1, n01)) {
+					indices[i] = 1;
+					index2 -= ((T) 1 << n01) * lay.combi(d - i - 1, n01);
+				} else {
+					indices[i] = 0;
+				}
+			}
+		}
+	}
+
+	/* Helper::pole_group for positions of type T */
+	template <typename T> static inline int layout_pole_group(int *levels, int *indices, T base, int cd, int *lp,
+			int d, int n, GridType type, T *offsets, T *left, T *right, int *outer, int *inner)
+	{
+		DirectLayout<T> lay(d, n);
+		int i, k, q = 0, pd = 0, s = 0, K;
+		int sl[d + 1], zeros[d + 1], bl[d + 1], bi[d + 1];
+		T off;
+
+		/* cd is the q-th interior dimension */
+		for (i = 0; i < d; i++) {
+			if (levels[i] != -1) {
+				if (i == cd)
+					q = pd;
+				pd++;
+			}
+			zeros[i] = 0;
+		}
+
+		for (i = 0; i < pd - 1; i++)
+			s += lp[i];
+		K = n - 1 - s;
+
+		*outer = 1;
+		for (i = 0; i < q; i++)
+			*outer <<= lp[i];
+		*inner = (1 << s) / *outer;
+
+		for (k = 0; k <= K; k++) {
+			for (i = 0; i < pd; i++)
+				sl[i] = i < q ? lp[i] : (i == q ? k : lp[i - 1]);
+			offsets[k] = base + layout_zb_gp2idx(lay, sl, zeros, pd);
+		}
+
+		*left = *right = -1;
+		if (type == GRID_BOUNDARY) {
+			/* the same subspace lp in the sparse grids on the left and right boundary in dimension cd */
+			for (i = 0; i < d; i++) {
+				bl[i] = levels[i];
+				bi[i] = levels[i] == -1 ? indices[i] : 0;
+			}
+			off = pd > 1 ? layout_zb_gp2idx(lay, lp, zeros, pd - 1) : 0;
+			bl[cd] = -1;
+			bi[cd] = 0;
+			*left = layout_gp2idx(lay, bl, bi) + off;
+			bi[cd] = 1;
+			*right = layout_gp2idx(lay, bl, bi) + off;
+		}
+
+		return K;
+	}
+}
+
+#endif /* LAYOUT_H_ */
@@ -0,0 +1,168 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2009, 2010 Alin Murarasu
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+#include "Numa.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <vector>
+
+using namespace fsg;
+
+/* from linux/mempolicy.h */
+#define FSG_MPOL_BIND 2
+#define FSG_MPOL_INTERLEAVE 3
+#define FSG_MPOL_MF_MOVE (1 << 1)
+#define FSG_MAX_NODES 1024
+
+/* parses a sysfs list like "0-3,8,10-11" */
+static std::vector<int> read_list(const char *path)
+{
+	std::vector<int> ids;
+	char buf[4096], *p;
+	int a, b, n;
+	FILE *f = fopen(path, "r");
+
+	if (f == NULL)
+		return ids;
+	if (fgets(buf, sizeof(buf), f) != NULL) {
+		p = buf;
+		while (sscanf(p, "%d%n", &a, &n) == 1) {
+			p += n;
+			b = a;
+			if (*p == '-' && sscanf(p + 1, "%d%n", &b, &n) == 1)
+				p += n + 1;
+			for (; a <= b; a++)
+				ids.push_back(a);
+			if (*p != ',')
+				break;
+			p++;
+		}
+	}
+	fclose(f);
+
+	return ids;
+}
+
+/* the ids of the nodes with memory; never empty */
+static std::vector<int> memory_nodes()
+{
+	std::vector<int> ids = read_list("/sys/devices/system/node/has_memory");
+
+	if (ids.empty())
+		ids.push_back(0);
+
+	return ids;
+}
+
+static const std::vector<int> &node_ids()
+{
+	static const std::vector<int> ids = memory_nodes();
+
+	return ids;
+}
+
+static long page_size()
+{
+	static long size = sysconf(_SC_PAGESIZE);
+
+	return size;
+}
+
+static int mbind_range(void *p, size_t size, int mode, unsigned long *mask)
+{
+#ifdef SYS_mbind
+	unsigned long start = (unsigned long) p & ~(page_size() - 1);
+
+	size += (unsigned long) p - start;
+	if (syscall(SYS_mbind, start, size, mode, mask, FSG_MAX_NODES + 1, FSG_MPOL_MF_MOVE) != 0)
+		return -1;
+
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+int Numa::nodes()
+{
+	return node_ids().size();
+}
+
+int Numa::pin(int node)
+{
+	char path[64];
+	std::vector<int> cpus;
+	cpu_set_t set;
+	size_t i;
+
+	if (node < 0 || node >= nodes())
+		return -1;
+
+	snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node_ids()[node]);
+	cpus = read_list(path);
+	if (cpus.empty())
+		return -1;
+
+	CPU_ZERO(&set);
+	for (i = 0; i < cpus.size(); i++)
+		if (cpus[i] < CPU_SETSIZE)
+			CPU_SET(cpus[i], &set);
+
+	return sched_setaffinity(0, sizeof(set), &set) ? -1 : 0;
+}
+
+int Numa::interleave(void *p, size_t size)
+{
+	unsigned long mask[FSG_MAX_NODES / (8 * sizeof(unsigned long))];
+	const std::vector<int> &ids = node_ids();
+	size_t i;
+
+	memset(mask, 0, sizeof(mask));
+	for (i = 0; i < ids.size(); i++)
+		if (ids[i] < FSG_MAX_NODES)
+			mask[ids[i] / (8 * sizeof(unsigned long))] |= 1UL << (ids[i] % (8 * sizeof(unsigned long)));
+
+	return mbind_range(p, size, FSG_MPOL_INTERLEAVE, mask);
+}
+
+int Numa::bind(void *p, size_t size, int node)
+{
+	unsigned long mask[FSG_MAX_NODES / (8 * sizeof(unsigned long))];
+	int id;
+
+	if (node < 0 || node >= nodes() || (id = node_ids()[node]) >= FSG_MAX_NODES)
+		return -1;
+
+	memset(mask, 0, sizeof(mask));
+	mask[id / (8 * sizeof(unsigned long))] |= 1UL << (id % (8 * sizeof(unsigned long)));
+
+	return mbind_range(p, size, FSG_MPOL_BIND, mask);
+}
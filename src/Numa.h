@@ -0,0 +1,76 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2009, 2010 Alin Murarasu
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+#ifndef NUMA_H_
+#define NUMA_H_
+
+#include <stddef.h>
+
+namespace fsg
+{
+	/**
+	 * @class Numa
+	 *
+	 * @brief NUMA topology, memory placement and thread pinning (Linux)
+	 *
+	 * The placement uses the mbind system call directly, so no libnuma is needed. Everything degrades
+	 * to a single node (and the calls to no-ops returning -1) where the topology is not available.
+	 *
+	 */
+	class Numa
+	{
+		public:
+			/**
+			 * @return The number of NUMA nodes with memory (1 if unknown)
+			 */
+			static int nodes();
+
+			/**
+			 * Pins the calling thread to the CPUs of a node
+			 * @param node The node
+			 * @return Returns 0 if successful
+			 */
+			static int pin(int node);
+
+			/**
+			 * Interleaves the pages of [p, p + size) over all nodes; pages already touched are moved
+			 * @param p Start of the memory (rounded down to a page boundary)
+			 * @param size Size in bytes
+			 * @return Returns 0 if successful
+			 */
+			static int interleave(void *p, size_t size);
+
+			/**
+			 * Places the pages of [p, p + size) on a node; pages already touched are moved
+			 * @param p Start of the memory (rounded down to a page boundary)
+			 * @param size Size in bytes
+			 * @param node The node
+			 * @return Returns 0 if successful
+			 */
+			static int bind(void *p, size_t size, int node);
+	};
+}
+
+#endif /* NUMA_H_ */
@@ -0,0 +1,628 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2009, 2010 Alin Murarasu
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+#include "OutOfCoreSparseGrid.h"
+#include "Helper.h"
+#include "Layout.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+using namespace fsg;
+
+/* a run of coefficients held in the buffer during one batch of hierarchization */
+typedef struct ooc_block_t {
+	int64_t offset;	/* position in the file, in floats */
+	int len;
+	int dirty;	/* 1 if the block is updated and has to be written back */
+	float *data;
+} ooc_block_t;
+
+/* a pole group: subspaces 0..K in the hierarchized dimension, plus the two boundary blocks (-1 if 0) */
+typedef struct ooc_group_t {
+	int first, K, left, right, outer, inner;
+} ooc_group_t;
+
+static bool by_offset(const ooc_block_t *a, const ooc_block_t *b)
+{
+	return a->offset < b->offset;
+}
+
+/* the positions in the file are 64-bit: the layout (see Layout.h) is computed in int64_t */
+typedef DirectLayout<int64_t> FileLayout;
+
+/* n choose k in floating point, to bound the sizes before they are computed exactly */
+static double combi_estimate(int n, int k)
+{
+	double c = 1;
+	int i;
+
+	for (i = k + 1; i <= n; i++)
+		c = c * i / (i - k);
+
+	return c;
+}
+
+/*
+ * the number of points of a grid, -1 if it is too large: the file size must fit in an off_t, and at most 2^48 points
+ * keep every intermediate product of the binomial coefficients and of the positions far below 2^63
+ */
+static int64_t grid_size(int d, int l, GridType type)
+{
+	int i, j, last = type == GRID_ZERO_BOUNDARY ? 0 : d;
+	double estimate = 0, z, limit;
+	int64_t s = 0;
+	FileLayout lay(d, l);
+
+	for (i = 0; i <= last; i++) {
+		for (j = 0, z = d - i == 0; j < l && d - i > 0; j++)
+			z += ldexp(combi_estimate(d - i - 1 + j, j), j);
+		estimate += ldexp(combi_estimate(d, i), i) * z;
+	}
+	limit = sizeof(off_t) < sizeof(int64_t) ? (double) 0x7fffffff / sizeof(float) : ldexp(1.0, 48);
+	if (estimate > limit)
+		return -1;
+
+	for (i = 0; i <= last; i++)
+		s += lay.groupSize(i);
+
+	return s;
+}
+
+/*
+ * the boundary pattern (levels -1, indices 0 or 1) of the kk-th sparse grid of dimensionality pd; the interior
+ * dimensions get level 0 and index 0, those of the first point of the sparse grid
+ */
+static void subgrid_pattern(int d, int l, int pd, int kk, int *levels, int *indices)
+{
+	FileLayout lay(d, l);
+	int64_t pos = kk * lay.zsize(pd);
+	int i;
+
+	for (i = 0; i < d - pd; i++)
+		pos += lay.groupSize(i);
+	layout_idx2gp(lay, pos, levels, indices);
+}
+
+/* reads n floats starting with the float at position offset */
+static int read_floats(int fd, float *buf, int64_t n, int64_t offset)
+{
+	char *p = (char *) buf;
+	size_t left = n * sizeof(float);
+	off_t pos = (off_t) offset * sizeof(float);
+	ssize_t r;
+
+	while (left > 0) {
+		r = pread(fd, p, left, pos);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			return -1;
+		p += r;
+		pos += r;
+		left -= r;
+	}
+
+	return 0;
+}
+
+/* writes n floats starting with the float at position offset */
+static int write_floats(int fd, float *buf, int64_t n, int64_t offset)
+{
+	char *p = (char *) buf;
+	size_t left = n * sizeof(float);
+	off_t pos = (off_t) offset * sizeof(float);
+	ssize_t r;
+
+	while (left > 0) {
+		r = pwrite(fd, p, left, pos);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			return -1;
+		p += r;
+		pos += r;
+		left -= r;
+	}
+
+	return 0;
+}
+
+/*
+ * the points are generated in file order (sparse grids, their regular grids, the points of each regular grid in
+ * row-major order) rather than converted from their positions, which would limit them to int
+ */
+OutOfCoreSparseGrid::OutOfCoreSparseGrid(int l, Function* f, const char *path, size_t memory, GridType type)
+{
+	int i, j, k, q, pd, kk, t0, chunk, num, idx;
+	int64_t p, r, pos;
+
+	d = f->getD();
+	this->l = l;
+	this->type = type;
+	budget = memory / sizeof(float);
+	buffer = NULL;
+	bufferSize = 0;
+	numOfGridPoints = 0;
+	fd = -1;
+
+	try {
+		if (d < 0 || l < 0)
+			throw 1;
+		if (type == GRID_MODIFIED)
+			throw 3;
+		numOfGridPoints = grid_size(d, l, type);
+		if (numOfGridPoints < 0) {
+			numOfGridPoints = 0;
+			throw 4;
+		}
+
+		fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+			throw 2;
+
+		/* the values and the coordinates of a chunk take (d + 1) floats per point */
+		chunk = budget / (d + 1);
+		if (chunk < 1)
+			chunk = 1;
+		if (reserve((size_t) chunk * (d + 1)))
+			throw 2;
+
+		float *vals = buffer;
+		float *gp = buffer + chunk;
+		int levels[d + 1], indices[d + 1], plevels[d + 1];
+
+		num = 0;
+		pos = 0;
+		for (pd = d; pd >= (type == GRID_ZERO_BOUNDARY ? d : 0); pd--)
+			for (kk = 0; kk < (1 << (d - pd)) * Helper::combi(d, d - pd); kk++) {
+				subgrid_pattern(d, l, pd, kk, levels, indices);
+				memset(plevels, 0, (pd > 0 ? pd : 1) * sizeof(int));
+
+				for (i = 0; i < (pd == 0 ? 1 : l); i++) {
+					plevels[0] = 0;
+					if (pd > 0)
+						plevels[pd - 1] = i;
+					do {
+						for (p = 0; p < (int64_t) 1 << i; p++) {
+							/* the last interior dimension varies fastest */
+							for (k = d - 1, q = pd - 1, r = p; k >= 0; k--) {
+								if (levels[k] == -1) {
+									gp[(long) num * d + k] = indices[k];
+								} else {
+									idx = r & ((1 << plevels[q]) - 1);
+									r >>= plevels[q];
+									gp[(long) num * d + k] = (2 * idx + 1) / (float) (2 << plevels[q--]);
+								}
+							}
+							if (++num == chunk) {
+								for (j = 0; j < num; j++)
+									vals[j] = f->getValue(gp + (long) j * d);
+								if (write_floats(fd, vals, num, pos))
+									throw 2;
+								pos += num;
+								num = 0;
+							}
+						}
+
+						if (pd == 0 || plevels[0] == i)
+							break;
+
+						k = 1;
+						while (plevels[k] == 0)
+							k++;
+						plevels[k]--;
+						t0 = plevels[0];
+						plevels[0] = 0;
+						plevels[k - 1] = t0 + 1;
+					} while (1);
+				}
+			}
+		for (j = 0; j < num; j++)
+			vals[j] = f->getValue(gp + (long) j * d);
+		if (num > 0 && write_floats(fd, vals, num, pos))
+			throw 2;
+	} catch (int e) {
+		if (e == 1)
+			std::cout
+					<< "Exception: number of dimensions and refinement level must be positive!"
+					<< std::endl;
+		else if (e == 3)
+			std::cout << "Exception: the modified linear basis is not supported out of core" << std::endl;
+		else if (e == 4)
+			std::cout << "Exception: the sparse grid is too large for a file" << std::endl;
+		else
+			std::cout << "Exception: cannot write the coefficients file " << path << std::endl;
+		if (fd >= 0)
+			close(fd);
+		fd = -1;
+		numOfGridPoints = 0;
+	}
+}
+
+OutOfCoreSparseGrid::OutOfCoreSparseGrid(int d, int l, const char *path, size_t memory, GridType type)
+{
+	this->d = d;
+	this->l = l;
+	this->type = type;
+	budget = memory / sizeof(float);
+	buffer = NULL;
+	bufferSize = 0;
+	numOfGridPoints = 0;
+	fd = -1;
+
+	try {
+		if (d < 0 || l < 0)
+			throw 1;
+		if (type == GRID_MODIFIED)
+			throw 3;
+		numOfGridPoints = grid_size(d, l, type);
+		if (numOfGridPoints < 0) {
+			numOfGridPoints = 0;
+			throw 4;
+		}
+
+		fd = open(path, O_RDWR);
+		if (fd < 0 || lseek(fd, 0, SEEK_END) < (off_t) numOfGridPoints * (off_t) sizeof(float))
+			throw 2;
+	} catch (int e) {
+		if (e == 1)
+			std::cout
+					<< "Exception: number of dimensions and refinement level must be positive!"
+					<< std::endl;
+		else if (e == 3)
+			std::cout << "Exception: the modified linear basis is not supported out of core" << std::endl;
+		else if (e == 4)
+			std::cout << "Exception: the sparse grid is too large for a file" << std::endl;
+		else
+			std::cout << "Exception: " << path << " does not hold a sparse grid of this size" << std::endl;
+		if (fd >= 0)
+			close(fd);
+		fd = -1;
+		numOfGridPoints = 0;
+	}
+}
+
+OutOfCoreSparseGrid::~OutOfCoreSparseGrid()
+{
+	if (fd >= 0)
+		close(fd);
+	free(buffer);
+}
+
+int OutOfCoreSparseGrid::reserve(size_t n)
+{
+	float *p;
+
+	if (n <= bufferSize)
+		return 0;
+	p = (float *) realloc(buffer, n * sizeof(float));
+	if (p == NULL)
+		return -1;
+	buffer = p;
+	bufferSize = n;
+
+	return 0;
+}
+
+float OutOfCoreSparseGrid::evaluate(float *coords)
+{
+	float val = 0.0f;
+
+	evaluate(coords, 1, &val);
+
+	return val;
+}
+
+/*
+ * same traversal as SparseGrid::evaluate, but sg1d is a window of budget floats that slides
+ * forward over the file; every regular grid is read exactly once
+ */
+int OutOfCoreSparseGrid::evaluate(float *coords, int n, float *vals)
+{
+	int k, i, j, index2, t0, pd, kk, len;
+	float left, prod, div, m;
+	int indices[d], plevels[d], levels[d];
+	int64_t pos, wbeg = 0, wend = 0, wlen;
+	float *nxcoords = coords;
+	std::vector<float> prod0s(n), pcoords((long) n * d + 1);
+	float *sg1d;
+
+	for (j = 0; j < n; j++)
+		vals[j] = 0;
+
+	try {
+		for (j = 0; j < n; j++)
+			for (i = 0; i < d; i++)
+				if (nxcoords[j * d + i] > 1 || nxcoords[j * d + i] < 0)
+					throw 1;
+		if (fd < 0 || reserve(std::max(budget, (size_t) 1 << (l > 0 ? l - 1 : 0))))
+			throw 2;
+
+		pos = 0;
+
+		for (pd = d; pd >= (type == GRID_ZERO_BOUNDARY ? d : 0); pd--) {
+			for (kk = 0; kk < (1 << (d - pd)) * Helper::combi(d, d - pd); kk++) {
+				/* the boundary dimensions of the current sparse grid */
+				subgrid_pattern(d, l, pd, kk, levels, indices);
+
+				for (j = 0; j < n; j++) {
+					prod0s[j] = 1.0f;
+					i = 0;
+					for (k = 0; k < d; k++) {
+						if (levels[k] == -1) {
+							if (indices[k] == 0)
+								prod0s[j] *= (1 - nxcoords[j * d + k]);
+							else
+								prod0s[j] *= nxcoords[j * d + k];
+						} else {
+							pcoords[(long) j * d + i++] = nxcoords[j * d + k];
+						}
+					}
+				}
+
+				memset(plevels, 0, (pd > 0 ? pd : 1) * sizeof(int));
+
+				/* regular grids of size 2^i; a 0-dimensional sparse grid is a single point */
+				for (i = 0; i < (pd == 0 ? 1 : l); i++) {
+					plevels[0] = 0;
+					if (pd > 0)
+						plevels[pd - 1] = i;
+					do {
+						/* slide the window if the regular grid is not entirely inside it */
+						len = 1 << i;
+						if (pos + len > wend) {
+							wbeg = pos;
+							wlen = std::min((int64_t) std::max(budget, (size_t) len), numOfGridPoints - pos);
+							if (read_floats(fd, buffer, wlen, wbeg))
+								throw 2;
+							wend = wbeg + wlen;
+						}
+						sg1d = buffer + (pos - wbeg);
+
+						for (j = 0; j < n; j++) {
+							prod = prod0s[j];
+							index2 = 0;
+							for (k = 0; k < pd; k++) {
+								div = (1.0f - 0.0f) / (1 << plevels[k]);
+								index2 = index2 * (1 << plevels[k])
+										+ (int) ((pcoords[(long) j * d + k] - 0.0f) / div);
+								left = (int) ((pcoords[(long) j * d + k] - 0.0f) / div) * div;
+								m = (2.0f * (pcoords[(long) j * d + k] - left) - div) / div;
+								prod *= 1.0f + m * ((m < 0.0f) - !(m < 0.0f));
+							}
+							vals[j] += prod * sg1d[index2];
+						}
+
+						pos += len;
+
+						if (pd == 0 || plevels[0] == i)
+							break;
+
+						k = 1;
+						while (plevels[k] == 0)
+							k++;
+						plevels[k]--;
+						t0 = plevels[0];
+						plevels[0] = 0;
+						plevels[k - 1] = t0 + 1;
+					} while (1);
+				}
+			}
+		}
+	} catch (int e) {
+		if (e == 1)
+			std::cout << "The coordinates are not in [0,1]^d domain" << std::endl;
+		else
+			std::cout << "Exception: cannot read the coefficients file" << std::endl;
+
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * dimension by dimension, hierarchizes every 0-boundary sparse grid that is not on the boundary
+ * in that dimension; the boundary values it needs are in other sparse grids, which are not
+ * changed by this pass
+ */
+int OutOfCoreSparseGrid::hierarchize()
+{
+	int cd, pd, kk;
+	int levels[d], indices[d];
+	int64_t index1;
+
+	if (fd < 0)
+		return -1;
+
+	for (cd = 0; cd < d; cd++) {
+		index1 = 0;
+		for (pd = d; pd >= (type == GRID_ZERO_BOUNDARY ? d : 1); pd--)
+			for (kk = 0; kk < (1 << (d - pd)) * Helper::combi(d, d - pd); kk++) {
+				subgrid_pattern(d, l, pd, kk, levels, indices);
+				if (levels[cd] != -1 && hierarchizeSubgrid(cd, index1, levels, indices))
+					return -1;
+				index1 += FileLayout(d, l).zsize(pd);
+			}
+	}
+
+	return 0;
+}
+
+/*
+ * The subspaces of the sparse grid are grouped into poles: all subspaces with the same levels in the
+ * other dimensions (lp) form one group, hierarchized by Helper::hierarchize_poles. Groups are collected
+ * until the budget is exhausted; their blocks are then sorted by file offset, coalesced into runs and
+ * read, updated and written back in one sequential sweep.
+ */
+int OutOfCoreSparseGrid::hierarchizeSubgrid(int cd, int64_t base, int *levels, int *indices)
+{
+	int i, k, pd = 0, K;
+	int lp[d];
+	int64_t offsets[l + 1], total, left, right;
+	std::vector<ooc_block_t> blocks;
+	std::vector<ooc_group_t> groups;
+	std::vector<ooc_block_t *> sorted;
+	std::vector<float *> poles;
+	ooc_group_t g;
+	ooc_block_t b;
+	int64_t run, end;
+	size_t j, next;
+	int more;
+
+	for (i = 0; i < d; i++)
+		if (levels[i] != -1)
+			pd++;
+
+	for (i = 0; i < pd - 1; i++)
+		lp[i] = 0;
+	total = 0;
+	more = 1;
+	while (more) {
+		/* lp = levels of the group in the other interior dimensions */
+		K = layout_pole_group<int64_t>(levels, indices, base, cd, lp, d, l, type, offsets, &left, &right, &g.outer, &g.inner);
+
+		g.first = blocks.size();
+		g.K = K;
+		for (k = 0; k <= K; k++) {
+			b.offset = offsets[k];
+			b.len = g.outer * g.inner << k;
+			b.dirty = 1;
+			blocks.push_back(b);
+		}
+		g.left = g.right = -1;
+		if (left != -1) {
+			b.len = g.outer * g.inner;
+			b.dirty = 0;
+			g.left = blocks.size();
+			b.offset = left;
+			blocks.push_back(b);
+			g.right = blocks.size();
+			b.offset = right;
+			blocks.push_back(b);
+		}
+		groups.push_back(g);
+		for (j = g.first; j < blocks.size(); j++)
+			total += blocks[j].len;
+
+		more = pd > 1 && Helper::next_levels(lp, pd - 1, l - 1);
+
+		/* flush when the next group could exceed the budget (a group is at most 3 * 2^l floats) */
+		if (more && total + (3 << l) <= (int64_t) budget)
+			continue;
+
+		/* sort the blocks of the batch by offset and merge adjacent ones into runs */
+		if (reserve(total))
+			return -1;
+		sorted.resize(blocks.size());
+		for (j = 0; j < blocks.size(); j++)
+			sorted[j] = &blocks[j];
+		std::sort(sorted.begin(), sorted.end(), by_offset);
+
+		run = 0;
+		for (j = 0; j < sorted.size(); j = next) {
+			end = sorted[j]->offset;
+			for (next = j; next < sorted.size() && sorted[next]->offset == end; next++) {
+				sorted[next]->data = buffer + run + (end - sorted[j]->offset);
+				end += sorted[next]->len;
+			}
+			if (read_floats(fd, buffer + run, end - sorted[j]->offset, sorted[j]->offset)) {
+				std::cout << "Exception: cannot read the coefficients file" << std::endl;
+				return -1;
+			}
+			run += end - sorted[j]->offset;
+		}
+
+		for (j = 0; j < groups.size(); j++) {
+			poles.resize(groups[j].K + 1);
+			for (k = 0; k <= groups[j].K; k++)
+				poles[k] = blocks[groups[j].first + k].data;
+			Helper::hierarchize_poles(&poles[0], groups[j].K,
+					groups[j].left >= 0 ? blocks[groups[j].left].data : NULL,
+					groups[j].right >= 0 ? blocks[groups[j].right].data : NULL,
+					groups[j].outer, groups[j].inner, type);
+		}
+
+		/* write back the runs that contain updated blocks */
+		for (j = 0; j < sorted.size(); j = next) {
+			end = sorted[j]->offset;
+			k = 0;
+			for (next = j; next < sorted.size() && sorted[next]->offset == end; next++) {
+				k |= sorted[next]->dirty;
+				end += sorted[next]->len;
+			}
+			if (k && write_floats(fd, sorted[j]->data, end - sorted[j]->offset, sorted[j]->offset)) {
+				std::cout << "Exception: cannot write the coefficients file" << std::endl;
+				return -1;
+			}
+		}
+
+		blocks.clear();
+		groups.clear();
+		total = 0;
+	}
+
+	return 0;
+}
+
+int OutOfCoreSparseGrid::read(int64_t index, int n, float *vals)
+{
+	if (fd < 0 || index < 0 || n < 0 || index + n > numOfGridPoints)
+		return -1;
+
+	return read_floats(fd, vals, n, index);
+}
+
+/* returns the size of the sparse grid */
+int64_t OutOfCoreSparseGrid::size() const
+{
+	return numOfGridPoints;
+}
+
+/* returns the number of dimensions */
+int OutOfCoreSparseGrid::getD()
+{
+	return d;
+}
+
+/* returns the refinement level */
+int OutOfCoreSparseGrid::getL()
+{
+	return l;
+}
+
+/* returns the kind of the sparse grid */
+GridType OutOfCoreSparseGrid::getType()
+{
+	return type;
+}
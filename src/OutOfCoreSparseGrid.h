@@ -0,0 +1,163 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2009, 2010 Alin Murarasu
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Function.h"
+#include "SparseGrid.h"
+
+#ifndef OUTOFCORESPARSEGRID_H_
+#define OUTOFCORESPARSEGRID_H_
+
+namespace fsg
+{
+	/**
+	* @class OutOfCoreSparseGrid
+	*
+	* @brief Sparse grid whose coefficients are kept in a file instead of main memory
+	*
+	* The file holds the coefficients as native floats, in the same order as the sg1d array of a
+	* SparseGrid of the same type. All operations work on blocks of whole subspaces (regular grids)
+	* and keep at most about memory bytes of coefficients in RAM; a single pole group
+	* (about 2^l coefficients) is the smallest unit and is always loaded, whatever the budget.
+	* Point counts and file positions are 64-bit, so the grid may exceed 2^31 points; a grid whose
+	* file size would not fit in an off_t is rejected by the constructors.
+	*
+	* Note: for all methods available it's up to the user to make sure he is in the [0,1]^d domain
+	*
+	*/
+	class OutOfCoreSparseGrid
+	{
+		public:
+			/**
+			 * Class constructor; samples f into a new file (an existing file is overwritten)
+			 * @param l Level of refinement
+			 * @param f Function to be represented using the sparse grid technique
+			 * @param path The file that stores the coefficients
+			 * @param memory Memory budget in bytes
+			 * @param type GRID_BOUNDARY or GRID_ZERO_BOUNDARY (GRID_MODIFIED is not supported)
+			 */
+			OutOfCoreSparseGrid(int l, Function* f, const char *path, size_t memory, GridType type = GRID_BOUNDARY);
+
+			/**
+			 * Class constructor; opens a file written by a previous OutOfCoreSparseGrid
+			 * @param d Number of dimensions
+			 * @param l Level of refinement
+			 * @param path The file that stores the coefficients
+			 * @param memory Memory budget in bytes
+			 * @param type GRID_BOUNDARY or GRID_ZERO_BOUNDARY (GRID_MODIFIED is not supported)
+			 */
+			OutOfCoreSparseGrid(int d, int l, const char *path, size_t memory, GridType type = GRID_BOUNDARY);
+
+			/**
+			 * Class destructor; the file is kept
+			 */
+			virtual ~OutOfCoreSparseGrid();
+
+			/**
+			 * @param coords The point at which we evaluate (interpolate) the sparse grid
+			 * Streams over the whole file, so prefer the batch version
+			 * @return The result of the evaluation
+			 */
+			float evaluate(float *coords);
+
+			/**
+			 * @param coords The set of points at which we evaluate (interpolate) the sparse grid
+			 * @param n The size of the set
+			 * @param vals The results of the evaluation
+			 * Evaluates the sparse grid at the points stored in coords in one sequential pass over the file
+			 * @return Returns 0 if successfull
+			 */
+			int evaluate(float *coords, int n, float *vals);
+
+			/**
+			 * Computes the hierarchical coefficients, one dimension after the other
+			 * @return Returns 0 if successful
+			 */
+			int hierarchize();
+
+			/**
+			 * @param index Position of the first coefficient
+			 * @param n Number of coefficients
+			 * @param vals Receives the coefficients index .. index + n - 1
+			 * @return Returns 0 if successful
+			 */
+			int read(int64_t index, int n, float *vals);
+
+			/**
+			 * The number of grid points composing the sparse grid
+			 * @return The size of the sparse grid (0 if the constructor failed)
+			 */
+			int64_t size() const;
+
+			/**
+			 * The number of dimensions of the sparse grid
+			 * @return The dimensionality of the sparse grid
+			 */
+			int getD();
+
+			/**
+			 * The refinement level of the sparse grid
+			 * @return The refinement level of the sparse grid
+			 */
+			int getL();
+
+			/**
+			 * The kind of the sparse grid
+			 * @return GRID_BOUNDARY or GRID_ZERO_BOUNDARY
+			 */
+			GridType getType();
+
+		private:
+			OutOfCoreSparseGrid(const OutOfCoreSparseGrid &);
+			OutOfCoreSparseGrid &operator=(const OutOfCoreSparseGrid &);
+
+			/**
+			 * Hierarchizes in dimension cd the 0-boundary sparse grid starting at base
+			 * @param cd The hierarchized dimension
+			 * @param base Position of the first point of the sparse grid
+			 * @param levels The l vector of the first point of the sparse grid
+			 * @param indices The i vector of the first point of the sparse grid
+			 * @return Returns 0 if successful
+			 */
+			int hierarchizeSubgrid(int cd, int64_t base, int *levels, int *indices);
+
+			/**
+			 * Makes sure the buffer holds at least n floats
+			 */
+			int reserve(size_t n);
+
+			int fd;
+			int64_t numOfGridPoints;
+			int d, l;
+			GridType type;
+			size_t budget;
+			float *buffer;
+			size_t bufferSize;
+	};
+}
+
+#endif /* OUTOFCORESPARSEGRID_H_ */
@@ -0,0 +1,107 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2009, 2010 Alin Murarasu
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+#include "SharedSparseGrid.h"
+
+using namespace fsg;
+
+SharedSparseGrid::SharedSparseGrid(SparseGrid *grid)
+	: grid(grid)
+{
+}
+
+SharedSparseGrid::SharedSparseGrid(SparseGrid &&grid)
+	: grid(new SparseGrid(std::move(grid)))
+{
+}
+
+float SharedSparseGrid::evaluate(float *coords) const
+{
+	return grid->evaluate(coords);
+}
+
+int SharedSparseGrid::evaluate(float *coords, int n, float *vals) const
+{
+	return grid->evaluate(coords, n, vals);
+}
+
+int SharedSparseGrid::evaluate(float *coords, int n, float *vals, int threads) const
+{
+	return grid->evaluate(coords, n, vals, threads);
+}
+
+float SharedSparseGrid::evaluate(float *coords, int threads) const
+{
+	return grid->evaluate(coords, threads);
+}
+
+float SharedSparseGrid::evaluate(float *coords, int maxLevel, float tol, float *bound) const
+{
+	return grid->evaluate(coords, maxLevel, tol, bound);
+}
+
+int SharedSparseGrid::evaluate(float *coords, int n, float *vals, int maxLevel, float tol, float *bound) const
+{
+	return grid->evaluate(coords, n, vals, maxLevel, tol, bound);
+}
+
+int SharedSparseGrid::evaluateTensor(float **axes, int *sizes, float *vals) const
+{
+	return grid->evaluateTensor(axes, sizes, vals);
+}
+
+const SparseGrid *SharedSparseGrid::get() const
+{
+	return grid.get();
+}
+
+long SharedSparseGrid::useCount() const
+{
+	return grid.use_count();
+}
+
+/* returns the size of the sparse grid */
+int SharedSparseGrid::size() const
+{
+	return grid->size();
+}
+
+/* returns the number of dimensions */
+int SharedSparseGrid::getD() const
+{
+	return grid->getD();
+}
+
+/* returns the refinement level */
+int SharedSparseGrid::getL() const
+{
+	return grid->getL();
+}
+
+/* returns the kind of the sparse grid */
+GridType SharedSparseGrid::getType() const
+{
+	return grid->getType();
+}
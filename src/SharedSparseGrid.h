@@ -0,0 +1,152 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2009, 2010 Alin Murarasu
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+#include <memory>
+
+#include "SparseGrid.h"
+
+#ifndef SHAREDSPARSEGRID_H_
+#define SHAREDSPARSEGRID_H_
+
+namespace fsg
+{
+	/**
+	 * @class SharedSparseGrid
+	 *
+	 * @brief Reference-counted, read-only handle to a sparse grid
+	 *
+	 * Copying a handle shares the grid (one atomic increment, no coefficients are copied); the grid is deleted
+	 * together with the last handle. The handle only offers the const methods of SparseGrid.
+	 *
+	 * Thread safety: the const methods of SparseGrid keep all their state on the stack and only read the grid,
+	 * so any number of threads may evaluate concurrently through one handle or through copies of it. Copies of
+	 * a handle may be made and destroyed in different threads; a single handle object must not be assigned
+	 * while other threads use it. The grid must not be changed anymore once it is shared: hierarchize (and set
+	 * the NUMA policy) before building the handle and drop every non-const pointer to it.
+	 *
+	 */
+	class SharedSparseGrid
+	{
+		public:
+			/**
+			 * Class constructor
+			 * @param grid The grid to share (not NULL), allocated with new; the handles take ownership
+			 */
+			SharedSparseGrid(SparseGrid *grid);
+
+			/**
+			 * Class constructor; the grid is moved into the handle
+			 * @param grid The grid to share, left empty
+			 */
+			SharedSparseGrid(SparseGrid &&grid);
+
+			/**
+			 * @param coords The point at which we evaluate (interpolate) the sparse grid
+			 * @return The result of the evaluation
+			 */
+			float evaluate(float *coords) const;
+
+			/**
+			 * @param coords The set of points at which we evaluate (interpolate) the sparse grid
+			 * @param n The size of the set
+			 * @param vals The results of the evaluation
+			 * @return Returns 0 if successfull
+			 */
+			int evaluate(float *coords, int n, float *vals) const;
+
+			/**
+			 * @param coords The set of points at which we evaluate (interpolate) the sparse grid
+			 * @param n The size of the set
+			 * @param vals The results of the evaluation
+			 * @param threads The number of threads to evaluate with; see SparseGrid::evaluate
+			 * @return Returns 0 if successfull
+			 */
+			int evaluate(float *coords, int n, float *vals, int threads) const;
+
+			/**
+			 * @param coords The point at which we evaluate (interpolate) the sparse grid
+			 * @param threads The number of threads to evaluate the point with; see SparseGrid::evaluate
+			 * @return The result of the evaluation
+			 */
+			float evaluate(float *coords, int threads) const;
+
+			/**
+			 * Evaluation of the subspaces of level sum below a cut; see SparseGrid::evaluate
+			 * @return The result of the evaluation
+			 */
+			float evaluate(float *coords, int maxLevel, float tol, float *bound) const;
+
+			/**
+			 * Evaluation of a set of points without the finest subspaces; see SparseGrid::evaluate
+			 * @return Returns 0 if successfull
+			 */
+			int evaluate(float *coords, int n, float *vals, int maxLevel, float tol, float *bound) const;
+
+			/**
+			 * Evaluation at all points of a tensor-product lattice; see SparseGrid::evaluateTensor
+			 * @return Returns 0 if successfull
+			 */
+			int evaluateTensor(float **axes, int *sizes, float *vals) const;
+
+			/**
+			 * @return The shared grid, for the const methods not forwarded by the handle
+			 */
+			const SparseGrid *get() const;
+
+			/**
+			 * @return The number of handles sharing the grid
+			 */
+			long useCount() const;
+
+			/**
+			 * The number of grid points composing the sparse grid
+			 * @return The size of the sparse grid
+			 */
+			int size() const;
+
+			/**
+			 * The number of dimensions of the sparse grid
+			 * @return The dimensionality of the sparse grid
+			 */
+			int getD() const;
+
+			/**
+			 * The refinement level of the sparse grid
+			 * @return The refinement level of the sparse grid
+			 */
+			int getL() const;
+
+			/**
+			 * The kind of the sparse grid
+			 * @return GRID_BOUNDARY, GRID_ZERO_BOUNDARY or GRID_MODIFIED
+			 */
+			GridType getType() const;
+
+		private:
+			std::shared_ptr<const SparseGrid> grid;
+	};
+}
+
+#endif /* SHAREDSPARSEGRID_H_ */
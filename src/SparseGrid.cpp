@@ -27,34 +27,100 @@
 #include "DataStructure.h"
 #include "Converter.h"
 #include "Helper.h"
+#include "Kernels.h"
+#include "HierarchizationPlan.h"
+#include "Instrumentation.h"
+#include "Numa.h"
+#include "TaskPool.h"
 
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include <iostream>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <map>
+#include <algorithm>
 
 using namespace fsg;
 
-SparseGrid::SparseGrid(int l, Function* f)
+SparseGrid::SparseGrid(int l, Function* f, GridType type, Allocator *allocator)
+	: SparseGrid(f->getD(), l, type, allocator)
 {
 	float gp[f->getD()];
-	int count;
 	int i;
 
-	d = f->getD();
+	if (sg1d == NULL)
+		return;
+
+	for (i = 0; i < numOfGridPoints; i++) {
+		if (type != GRID_BOUNDARY)
+			Converter::zb_idx2gp(i, gp, d);
+		else
+			Converter::idx2gp(i, gp, d, l);
+		sg1d[i] = f->getValue(gp);
+	}
+}
+
+SparseGrid::SparseGrid(int d, int l, float *values, GridType type, BufferMode mode, Allocator *allocator)
+	: SparseGrid(d, l, type, allocator, mode == BUFFER_WRAP ? values : NULL)
+{
+	if (sg1d == NULL)
+		return;
+
+	try {
+		if (values == NULL)
+			throw 1;
+	} catch (int e) {
+		std::cout << "Exception: no nodal values given!" << std::endl;
+		memset(sg1d, 0, numOfGridPoints * sizeof(float));
+		return;
+	}
+
+	if (!external)
+		memcpy(sg1d, values, numOfGridPoints * sizeof(float));
+}
+
+/* a grid whose coefficients are left uninitialized, or held by the buffer of the caller */
+SparseGrid::SparseGrid(int d, int l, GridType type, Allocator *allocator, float *buffer)
+{
+	this->d = d;
+	numaPolicy = NUMA_NONE;
+	numaThreads = 1;
+	replicas = NULL;
+	replicaBackings = NULL;
+	ranges = NULL;
+	sg1d = NULL;
+	numOfGridPoints = 0;
+	numSubspaces = 0;
+	subspaceStart = NULL;
+	subspaceLevel = NULL;
+	maxSurplus = NULL;
+	levelBounds = NULL;
+	reorderMin = 0;
+	hierarchized = 0;
+	external = 0;
+	this->allocator = allocator != NULL ? allocator : Allocator::standard();
+	backing = ALLOC_DEFAULT;
 
 	try {
 		if (d < 0 || l < 0)
 			throw 1;
-		this->d = d;
 		this->l = l;
-		numOfGridPoints = size(d, l);
+		this->type = type;
+		if (type != GRID_BOUNDARY)
+			numOfGridPoints = Helper::zerob_size(d, l);
+		else
+			numOfGridPoints = size(d, l);
 		
-		sg1d = (float*) malloc(numOfGridPoints * sizeof(float));
-
-		for (i = 0; i < numOfGridPoints; i++) {
-			Converter::idx2gp(i, gp, d, l);
-			sg1d[i] = f->getValue(gp);
+		if (buffer != NULL) {
+			sg1d = buffer;
+			backing = ALLOC_CUSTOM;
+			external = 1;
+		} else {
+			sg1d = (float*) this->allocator->allocate(numOfGridPoints * sizeof(float), &backing);
 		}
 	} catch (int e) {
 		std::cout
@@ -65,17 +131,124 @@ SparseGrid::SparseGrid(int l, Function* f)
 
 SparseGrid::~SparseGrid()
 {
-	free(sg1d);
+	releaseNuma();
+	releaseCoefficients();
+	releaseBounds();
+}
+
+SparseGrid::SparseGrid(SparseGrid &&other)
+{
+	take(other);
+}
+
+SparseGrid &SparseGrid::operator=(SparseGrid &&other)
+{
+	if (this != &other) {
+		releaseNuma();
+		releaseCoefficients();
+		releaseBounds();
+		take(other);
+	}
+
+	return *this;
+}
+
+/* the members are copied one by one, then other gets the state of a grid without coefficients */
+void SparseGrid::take(SparseGrid &other)
+{
+	numOfGridPoints = other.numOfGridPoints;
+	sg1d = other.sg1d;
+	d = other.d;
+	l = other.l;
+	type = other.type;
+	numaPolicy = other.numaPolicy;
+	numaThreads = other.numaThreads;
+	allocator = other.allocator;
+	backing = other.backing;
+	replicas = other.replicas;
+	replicaBackings = other.replicaBackings;
+	ranges = other.ranges;
+	numSubspaces = other.numSubspaces;
+	subspaceStart = other.subspaceStart;
+	subspaceLevel = other.subspaceLevel;
+	maxSurplus = other.maxSurplus;
+	levelBounds = other.levelBounds;
+	reorderMin = other.reorderMin;
+	hierarchized = other.hierarchized;
+	external = other.external;
+
+	other.numOfGridPoints = 0;
+	other.sg1d = NULL;
+	other.numaPolicy = NUMA_NONE;
+	other.numaThreads = 1;
+	other.backing = ALLOC_DEFAULT;
+	other.replicas = NULL;
+	other.replicaBackings = NULL;
+	other.ranges = NULL;
+	other.numSubspaces = 0;
+	other.subspaceStart = NULL;
+	other.subspaceLevel = NULL;
+	other.maxSurplus = NULL;
+	other.levelBounds = NULL;
+	other.hierarchized = 0;
+	other.external = 0;
+}
+
+void SparseGrid::releaseCoefficients()
+{
+	if (!external)
+		allocator->release(sg1d, numOfGridPoints * sizeof(float), backing);
+	sg1d = NULL;
+	external = 0;
 }
 
 /* evaluates (or interpolates) the sparse grid at point coords inside the [0, 1]^d domain */
-float SparseGrid::evaluate(float *coords)
+float SparseGrid::evaluate(float *coords) const
+{
+	return evaluateLevels(coords, l);
+}
+
+/* evaluates only the subspaces of level sum below maxLevel, returns a bound of the skipped contributions */
+float SparseGrid::evaluate(float *coords, int maxLevel, float tol, float *bound) const
+{
+	return evaluateLevels(coords, cutLevel(maxLevel, tol, bound));
+}
+
+/* prod times the pd 1-dimensional basis functions of a subspace at pcoords; index receives the position of the
+   coefficient inside the subspace */
+static inline float hat_product(float prod, const float *pcoords, const int *plevels, int pd, GridType type, int *index)
+{
+	int k, index2 = 0;
+	float left, div, m;
+
+	if (type == GRID_MODIFIED) {
+		for (k = 0; k < pd; k++)
+			prod *= Helper::modified_basis(pcoords[k], plevels[k], &index2);
+	} else {
+		for (k = 0; k < pd; k++) {
+			div = (1.0f - 0.0f) / (1 << plevels[k]);
+			index2 = index2 * (1 << plevels[k])
+					+ (int) ((pcoords[k] - 0.0f) / div);
+			left = (int) ((pcoords[k] - 0.0f) / div) * div;
+			m = (2.0f * (pcoords[k] - left) - div) / div;
+			prod *= 1.0f + m * ((m < 0.0f) - !(m < 0.0f));
+		}
+	}
+	*index = index2;
+
+	return prod;
+}
+
+/* evaluates the subspaces of level sum i < cut */
+float SparseGrid::evaluateLevels(float *coords, int cut) const
 {
 	int k, i, index1, index2, t0, pd, kk;
-	float left, prod, val = 0, div, m, prod0;
+	float prod, val = 0, prod0;
 	int indices[d], plevels[d], levels[d];
 	float pcoords[d];
 	float *sg1d = this->sg1d;
+	FSG_INST(unsigned long long t_start = Instrumentation::nanoseconds(), c0, c1;
+		unsigned long long subspaces = 0, cyc_setup = 0, cyc_hats = 0, cyc_gather = 0;)
 
 	try {
 		for (i = 0; i < d; i++)
@@ -85,14 +258,16 @@ float SparseGrid::evaluate(float *coords)
 		index1 = 0;
 
 		/* loop over groups of sparse grids of the same dimensionality
-		 pd = projection dimensionality */
-		for (pd = d; pd >= 0; pd--) {
+		 pd = projection dimensionality; a 0-boundary grid is just the first (d-dimensional) group */
+		for (pd = d; pd >= (type != GRID_BOUNDARY ? d : 0); pd--) {
 			/* loop over sparse grids of the same dimensionality */
 			for (kk = 0; kk < (1 << (d - pd)) * Helper::combi(d, d - pd); kk++) {
+				FSG_INST(c0 = Instrumentation::cycles();)
 				/* convert index pointing to the current sparse grid to (l, i) */
 				Converter::idx2gp(index1, levels, indices, d, l);
 
-				/* move index to next sparse grid in the group */
+				/* the coefficients of the current sparse grid; move index to next sparse grid in the group */
+				sg1d = this->sg1d + index1;
 				index1 += Helper::zerob_size(pd, l);
 
 				/* prod0 is the same for all the regular grids composing the current sparse grid */
@@ -108,11 +283,13 @@ float SparseGrid::evaluate(float *coords)
 						pcoords[i++] = coords[k];
 					}
 				}
+				FSG_INST(c1 = Instrumentation::cycles(); cyc_setup += c1 - c0;)
 
 				/* no need to proceed if the sparse grids are 0-dimensional */
 				if (pd == 0) {
-					val += prod0 * sg1d[0];
-					sg1d++;
+					if (cut > 0)
+						val += prod0 * sg1d[0];
+					FSG_INST(subspaces++; cyc_gather += Instrumentation::cycles() - c1;)
 					continue;
 				}
 
@@ -120,28 +297,21 @@ float SparseGrid::evaluate(float *coords)
 				 plevels = projection levels */
 				memset(plevels, 0, pd * sizeof(int));
 
-				/* start evaluation of 0-boundary sparse grids */
-				for (i = 0; i < l; i++) {
+				/* start evaluation of 0-boundary sparse grids (the levels from cut on are skipped) */
+				for (i = 0; i < cut; i++) {
 					plevels[0] = 0;
 					plevels[pd - 1] = i;
 					do {
-						/* initilize production with initial product! */
-						prod = prod0;
-						index2 = 0;
-						/* multiply pd 1-dimensional hat functions */
-						for (k = 0; k < pd; k++) {
-							div = (1.0f - 0.0f) / (1 << plevels[k]);
-							index2 = index2 * (1 << plevels[k])
-									+ (int) ((pcoords[k] - 0.0f) / div);
-							left = (int) ((pcoords[k] - 0.0f) / div) * div;
-							m = (2.0f * (pcoords[k] - left) - div) / div;
-							prod *= 1.0f + m * ((m < 0.0f) - !(m < 0.0f));
-						}
+						FSG_INST(c0 = Instrumentation::cycles();)
+						/* multiply the initial product with pd 1-dimensional hat functions */
+						prod = hat_product(prod0, pcoords, plevels, pd, type, &index2);
+						FSG_INST(c1 = Instrumentation::cycles(); cyc_hats += c1 - c0;)
 
 						/* multiply with corresponding hierarchical coefficient */
 						prod *= sg1d[index2];
 						/* add contribution to the interpolation result */
 						val += prod;
+						FSG_INST(subspaces++; cyc_gather += Instrumentation::cycles() - c1;)
 
 						/* move to the next regular (full) grid of the current sparse grid of dimensionality pd */
 						sg1d += 1 << i;
@@ -167,18 +337,74 @@ float SparseGrid::evaluate(float *coords)
 	} catch (int i) {
 		std::cout << "The coordinates are not in [0,1]^d domain" << std::endl;
 	}
+
+	FSG_INST(Instrumentation::add(INST_SUBSPACES, subspaces);
+		Instrumentation::add(INST_COEFFICIENTS, subspaces);
+		Instrumentation::add(INST_CYCLES_SETUP, cyc_setup);
+		Instrumentation::add(INST_CYCLES_HATS, cyc_hats);
+		Instrumentation::add(INST_CYCLES_GATHER, cyc_gather);
+		Instrumentation::addLatency(INST_OP_EVALUATE, Instrumentation::nanoseconds() - t_start);)
+
 	return val;
 }
 
 /* evaluates (or interpolates) the sparse grid at points stored in coords inside the [0, 1]^d domain */
-int SparseGrid::evaluate(float *coords, int n, float *vals)
+int SparseGrid::evaluate(float *coords, int n, float *vals) const
 {
-	int k, i, j, index1, index2, t0, pd, kk;
-	float left, prod, div, m, prod0s[n];
-	int indices[d], plevels[d], levels[d];
-	float pcoords[n][d];
+	return evaluateOrdered(coords, n, vals, l);
+}
+
+int SparseGrid::evaluate(float *coords, int n, float *vals, int maxLevel, float tol, float *bound) const
+{
+	return evaluateOrdered(coords, n, vals, cutLevel(maxLevel, tol, bound));
+}
+
+/* automatic reordering: only batches this large, on grids that do not fit in the L2 cache */
+#define REORDER_MIN_POINTS 128
+#define REORDER_MIN_BYTES (256 * 1024)
+
+/*
+ * evaluates the points in Morton order if reordering applies to this batch; consecutive points then mostly
+ * fall into the same cells of the finer levels and gather the same coefficients
+ */
+int SparseGrid::evaluateOrdered(float *coords, int n, float *vals, int cut) const
+{
+	int j, k, ret;
+
+	if (reorderMin == 0 || (reorderMin > 0 && n < reorderMin) || (reorderMin < 0 && (n < REORDER_MIN_POINTS
+			|| numOfGridPoints * sizeof(float) < REORDER_MIN_BYTES)))
+		return evaluateLevels(coords, n, vals, cut);
+
+	std::vector<int> order(n);
+	std::vector<float> sorted((long) n * d + 1), svals(n);
+
+	Helper::morton_order(coords, n, d, &order[0]);
+	for (j = 0; j < n; j++)
+		for (k = 0; k < d; k++)
+			sorted[(long) j * d + k] = coords[(long) order[j] * d + k];
+
+	ret = evaluateLevels(&sorted[0], n, &svals[0], cut);
+	for (j = 0; j < n; j++)
+		vals[order[j]] = svals[j];
+
+	return ret;
+}
+
+void SparseGrid::setReordering(int minPoints)
+{
+	reorderMin = minPoints;
+}
+
+int SparseGrid::evaluateLevels(float *coords, int n, float *vals, int cut) const
+{
+	int k, i, j, index1, t0, pd, kk;
+	float prod0s[n], prods[n];
+	int indices[d], plevels[d], levels[d], index[n];
+	float pcoords[d][n];
 	float *sg1d = this->sg1d;
 	float (*nxcoords)[d] = (float (*)[d]) coords;
+	FSG_INST(unsigned long long t_start = Instrumentation::nanoseconds(), c0, c1;
+		unsigned long long subspaces = 0, cyc_setup = 0, cyc_hats = 0, cyc_gather = 0;)
 
 	for (j = 0; j < n; j++)
 		vals[j] = 0;
@@ -191,14 +417,16 @@ int SparseGrid::evaluate(float *coords, int n, float *vals)
 		index1 = 0;
 
 		/* loop over groups of sparse grids of the same dimensionality
-		 pd = projection dimensionality */
-		for (pd = d; pd >= 0; pd--) {
+		 pd = projection dimensionality; a 0-boundary grid is just the first (d-dimensional) group */
+		for (pd = d; pd >= (type != GRID_BOUNDARY ? d : 0); pd--) {
 			/* loop over sparse grids of the same dimensionality */
 			for (kk = 0; kk < (1 << (d - pd)) * Helper::combi(d, d - pd); kk++) {
+				FSG_INST(c0 = Instrumentation::cycles();)
 				/* convert index pointing to the current sparse grid to (l, i) */
 				Converter::idx2gp(index1, levels, indices, d, l);
 
-				/* move index to next sparse grid in the group */
+				/* the coefficients of the current sparse grid; move index to next sparse grid in the group */
+				sg1d = this->sg1d + index1;
 				index1 += Helper::zerob_size(pd, l);
 
 				for (j = 0; j < n; j++) {
@@ -212,16 +440,17 @@ int SparseGrid::evaluate(float *coords, int n, float *vals)
 							else
 								prod0s[j] *= nxcoords[j][k];
 						} else {
-							pcoords[j][i++] = nxcoords[j][k];
+							pcoords[i++][j] = nxcoords[j][k];
 						}
 					}
 				}
+				FSG_INST(c1 = Instrumentation::cycles(); cyc_setup += c1 - c0;)
 
 				/* no need to proceed if the sparse grids are 0-dimensional */
 				if (pd == 0) {
-					for (j = 0; j < n; j++)
+					for (j = 0; j < n && cut > 0; j++)
 						vals[j] += prod0s[j] * sg1d[0];
-					sg1d++;
+					FSG_INST(subspaces++; cyc_gather += Instrumentation::cycles() - c1;)
 					continue;
 				}
 
@@ -229,31 +458,21 @@ int SparseGrid::evaluate(float *coords, int n, float *vals)
 				 plevels = projection levels */
 				memset(plevels, 0, pd * sizeof(int));
 
-				/* start evaluation of 0-boundary sparse grids */
-				for (i = 0; i < l; i++) {
+				/* start evaluation of 0-boundary sparse grids (the levels from cut on are skipped) */
+				for (i = 0; i < cut; i++) {
 					plevels[0] = 0;
 					plevels[pd - 1] = i;
 					do {
-						/* for each evaluation point */
-						for (j = 0; j < n; j++) {
-							/* initilize production with initial product! */
-							prod = prod0s[j];
-							index2 = 0;
-							/* multiply pd 1-dimensional hat functions */
-							for (k = 0; k < pd; k++) {
-								div = (1.0f - 0.0f) / (1 << plevels[k]);
-								index2 = index2 * (1 << plevels[k])
-										+ (int) ((pcoords[j][k] - 0.0f) / div);
-								left = (int) ((pcoords[j][k] - 0.0f) / div) * div;
-								m = (2.0f * (pcoords[j][k] - left) - div) / div;
-								prod *= 1.0f + m * ((m < 0.0f) - !(m < 0.0f));
-							}
+						FSG_INST(c0 = Instrumentation::cycles();)
+						/* multiply pd 1-dimensional hat functions, for all the points at once */
+						memcpy(prods, prod0s, n * sizeof(float));
+						Kernels::hats(&pcoords[0][0], n, pd, plevels, type, prods, index);
+						FSG_INST(c1 = Instrumentation::cycles(); cyc_hats += c1 - c0;)
 
-							/* multiply with corresponding hierarchical coefficient */
-							prod *= sg1d[index2];
-							/* add contribution to the interpolation result */
-							vals[j] += prod;
-						}
+						/* add the contributions of the corresponding hierarchical coefficients */
+						Kernels::gather(sg1d, index, prods, n, vals);
+						FSG_INST(cyc_gather += Instrumentation::cycles() - c1;)
+						FSG_INST(subspaces++;)
 
 						/* move to the next regular (full) grid of the current sparse grid of dimensionality pd */
 						sg1d += 1 << i;
@@ -281,48 +500,1181 @@ int SparseGrid::evaluate(float *coords, int n, float *vals)
 		
 		return -1;
 	}
+
+	FSG_INST(Instrumentation::add(INST_SUBSPACES, subspaces);
+		Instrumentation::add(INST_COEFFICIENTS, subspaces * n);
+		Instrumentation::add(INST_CYCLES_SETUP, cyc_setup);
+		Instrumentation::add(INST_CYCLES_HATS, cyc_hats);
+		Instrumentation::add(INST_CYCLES_GATHER, cyc_gather);
+		Instrumentation::addLatency(INST_OP_EVALUATE_BATCH, Instrumentation::nanoseconds() - t_start);)
 	
 	return 0;
 }
 
+/* the tables and the levels of a sum-factorized lattice evaluation, see SparseGrid::evaluateTensor */
+typedef struct tensor_ctx_t {
+	int d, l;
+	GridType type;
+	const float *sg1d;
+	int *sizes;
+	std::vector<std::vector<int> > cells;		/* per (dimension, level): the cell of every axis point */
+	std::vector<std::vector<float> > bases;		/* per (dimension, level): the basis value at every axis point */
+	std::vector<std::vector<float> > partial;	/* per dimension k: the sum for the levels g[k ..] */
+	int *g;						/* levels 0 .. l - 1, or l and l + 1 for the boundary functions */
+} tensor_ctx_t;
+
+/* the number of coefficients of a subspace along one dimension */
+static inline int tensor_shape(int g, int l)
+{
+	return g < l ? 1 << g : 1;
+}
+
+/*
+ * The sum over the levels g[0 .. k - 1] of the subspaces with the levels g[k ..], evaluated at the lattice points
+ * along the dimensions 0 .. k - 1 only: an array (sizes[0] x .. x sizes[k - 1]) x (shape of g[k] x .. x shape of
+ * g[d - 1]), row-major. For k = 0 these are the coefficients of the subspace g. used is the level sum of g[k ..].
+ * The level g[k - 1] is contracted for each of its values and the results are added up, so every sum over the
+ * lower dimensions is computed once for all the subspaces that share it. The sum for k = d is added to out.
+ */
+static const float *tensor_partial(tensor_ctx_t &c, int k, int used, float *out)
+{
+	int j, g, o, m, r, cell, shape, outer = 1, inner = 1, levels[c.d], indices[c.d];
+	const float *src, *s;
+	float *acc, *dst, b;
+
+	if (k == 0) {
+		for (j = 0; j < c.d; j++) {
+			levels[j] = c.g[j] < c.l ? c.g[j] : -1;
+			indices[j] = c.g[j] < c.l ? 0 : c.g[j] - c.l;
+		}
+
+		return c.sg1d + (c.type != GRID_BOUNDARY ? Converter::zb_gp2idx(levels, indices, c.d)
+				: Converter::gp2idx(levels, indices, c.d, c.l));
+	}
+
+	for (j = 0; j < k - 1; j++)
+		outer *= c.sizes[j];
+	for (j = k; j < c.d; j++)
+		inner *= tensor_shape(c.g[j], c.l);
+	if (out != NULL) {
+		acc = out;
+	} else {
+		c.partial[k].assign((long) outer * c.sizes[k - 1] * inner, 0.0f);
+		acc = &c.partial[k][0];
+	}
+
+	/* the boundary functions, then the levels that keep the level sum of the interior subspaces below l */
+	for (g = c.type == GRID_BOUNDARY ? c.l + 1 : c.l - 1; g >= 0; g--) {
+		if (g < c.l && used + g > c.l - 1)
+			continue;
+		c.g[k - 1] = g;
+		src = tensor_partial(c, k - 1, used + (g < c.l ? g : 0), NULL);
+		shape = tensor_shape(g, c.l);
+		const int *cells = &c.cells[(k - 1) * (c.l + 2) + g][0];
+		const float *bases = &c.bases[(k - 1) * (c.l + 2) + g][0];
+
+		for (o = 0; o < outer; o++)
+			for (m = 0; m < c.sizes[k - 1]; m++) {
+				b = bases[m];
+				cell = cells[m];
+				s = src + ((long) o * shape + cell) * inner;
+				dst = acc + ((long) o * c.sizes[k - 1] + m) * inner;
+				for (r = 0; r < inner; r++)
+					dst[r] += b * s[r];
+			}
+	}
+
+	return acc;
+}
+
+/*
+ * the tables hold the cell and the basis value of every axis point for each level of each dimension;
+ * the entries l and l + 1 are the boundary functions 1 - x and x
+ */
+int SparseGrid::evaluateTensor(float **axes, int *sizes, float *vals) const
+{
+	int k, m, c, lv, total = 1;
+	int g[d + 1];
+	float x;
+	tensor_ctx_t ctx;
+
+	for (k = 0; k < d; k++) {
+		total *= sizes[k];
+		for (m = 0; m < sizes[k]; m++)
+			if (axes[k][m] > 1 || axes[k][m] < 0) {
+				std::cout << "The coordinates are not in [0,1]^d domain" << std::endl;
+				return -1;
+			}
+	}
+	for (m = 0; m < total; m++)
+		vals[m] = 0;
+	if (total == 0 || d == 0)
+		return 0;
+
+	ctx.d = d;
+	ctx.l = l;
+	ctx.type = type;
+	ctx.sg1d = sg1d;
+	ctx.sizes = sizes;
+	ctx.g = g;
+	ctx.cells.resize(d * (l + 2));
+	ctx.bases.resize(d * (l + 2));
+	ctx.partial.resize(d + 1);
+
+	for (k = 0; k < d; k++)
+		for (lv = 0; lv < l + 2; lv++) {
+			std::vector<int> &tc = ctx.cells[k * (l + 2) + lv];
+			std::vector<float> &tb = ctx.bases[k * (l + 2) + lv];
+
+			tc.assign(sizes[k], 0);
+			tb.resize(sizes[k]);
+			for (m = 0; m < sizes[k]; m++) {
+				x = axes[k][m];
+				if (lv >= l) {
+					tb[m] = lv == l ? 1 - x : x;
+				} else if (type == GRID_MODIFIED) {
+					tb[m] = Helper::modified_basis(x, lv, &tc[m]);
+				} else {
+					c = std::min((int) (x * (1 << lv)), (1 << lv) - 1);
+					tc[m] = c;
+					tb[m] = 1.0f - fabsf(2.0f * (x * (1 << lv) - c) - 1.0f);
+				}
+			}
+		}
+
+	/* the last dimension is contracted straight into vals */
+	tensor_partial(ctx, d, 0, vals);
+
+	return 0;
+}
+
+/* the node of thread t out of threads; consecutive threads share a node */
+static int numa_node(int t, int threads)
+{
+	return (long) t * Numa::nodes() / threads;
+}
+
+/* evaluates the sparse grid at points stored in coords using several threads, placed according to the NUMA policy */
+int SparseGrid::evaluate(float *coords, int n, float *vals, int threads) const
+{
+	int i, j, t;
+	std::vector<std::thread> workers;
+	std::vector<std::vector<float> > partial;
+
+	for (j = 0; j < n; j++)
+		vals[j] = 0;
+
+	try {
+		for (j = 0; j < n; j++)
+			for (i = 0; i < d; i++)
+				if (coords[(long) j * d + i] > 1 || coords[(long) j * d + i] < 0)
+					throw 1;
+	} catch (int i) {
+		std::cout << "The coordinates are not in [0,1]^d domain" << std::endl;
+
+		return -1;
+	}
+	if (n == 0)
+		return 0;
+
+	if (numaPolicy == NUMA_PARTITION) {
+		/* every thread evaluates its range of subspaces at all points; the partial sums are added up */
+		threads = numaThreads;
+		partial.resize(threads);
+		for (t = 0; t < threads; t++)
+			workers.push_back(std::thread([this, t, threads, coords, n, &partial]() {
+				Numa::pin(numa_node(t, threads));
+				partial[t].assign(n, 0.0f);
+				Helper::evaluate_range(sg1d + ranges[t], ranges[t], ranges[t + 1], d, l, type, coords, n, &partial[t][0]);
+			}));
+		for (t = 0; t < threads; t++)
+			workers[t].join();
+		for (t = 0; t < threads; t++)
+			for (j = 0; j < n; j++)
+				vals[j] += partial[t][j];
+
+		return 0;
+	}
+
+	/* every thread evaluates the whole grid at its share of the points */
+	if (threads < 1)
+		threads = 1;
+	for (t = 0; t < threads; t++)
+		workers.push_back(std::thread([this, t, threads, coords, n, vals]() {
+			int first = (long) n * t / threads, last = (long) n * (t + 1) / threads;
+			int node = numa_node(t, threads);
+			float *coefs = sg1d;
+
+			if (numaPolicy != NUMA_NONE)
+				Numa::pin(node);
+			if (numaPolicy == NUMA_REPLICATE)
+				coefs = replicas[node];
+			Helper::evaluate_range(coefs, 0, numOfGridPoints, d, l, type, coords + (long) first * d, last - first, vals + first);
+		}));
+	for (t = 0; t < threads; t++)
+		workers[t].join();
+
+	return 0;
+}
+
+/* the largest number of regular grids evaluated by one task of a parallel single point evaluation */
+#define TASK_SUBSPACES 512
+
+/*
+ * A task of a parallel single point evaluation: a run of count whole sparse grids starting at index1, or (count 0)
+ * a block of the regular grids of level sum level of the sparse grid at index1. The levels of the block start as
+ * states[state .. state + pd - 1] and the iterator of evaluateLevels runs over their first prefix entries only.
+ */
+typedef struct eval_task_t {
+	int index1;
+	int count;
+	int pos;	/* position of the first coefficient of a block */
+	int level;
+	int prefix;
+	int state;
+} eval_task_t;
+
+/* a parallel single point evaluation, as seen by the tasks run by the pool */
+typedef struct eval_job_t {
+	const float *sg1d;
+	const eval_task_t *tasks;
+	const int *states;
+	const float *coords;
+	float *partial;
+	int d, l;
+	GridType type;
+} eval_job_t;
+
+/*
+ * Cuts the regular grids of level sum level whose levels from prefix on are fixed (plevels[prefix ..]) into blocks
+ * of at most TASK_SUBSPACES; rest is the sum of the other levels. The iterator lowers plevels[prefix - 1] from rest
+ * to 0, so the regular grids with the same value follow each other. Returns the position after the regular grids.
+ */
+static int split_level(std::vector<eval_task_t> &tasks, std::vector<int> &states, int index1, int pos, int pd,
+		int *plevels, int prefix, int rest, int level)
+{
+	int t, count = Helper::combi(rest + prefix - 1, prefix - 1);
+	eval_task_t task;
+
+	if (count > TASK_SUBSPACES && prefix > 1) {
+		for (t = rest; t >= 0; t--) {
+			plevels[prefix - 1] = t;
+			pos = split_level(tasks, states, index1, pos, pd, plevels, prefix - 1, rest - t, level);
+		}
+
+		return pos;
+	}
+
+	memset(plevels, 0, (prefix - 1) * sizeof(int));
+	plevels[prefix - 1] = rest;
+	task.index1 = index1;
+	task.count = 0;
+	task.pos = pos;
+	task.level = level;
+	task.prefix = prefix;
+	task.state = states.size();
+	states.insert(states.end(), plevels, plevels + pd);
+	tasks.push_back(task);
+
+	return pos + (count << level);
+}
+
+/* the tasks of a parallel single point evaluation, in sg1d order; small sparse grids are grouped, large ones split */
+static void split_grid(int d, int l, GridType type, std::vector<eval_task_t> &tasks, std::vector<int> &states)
+{
+	int pd, kk, i, pos, zsize, cost, run = 0, index1 = 0;
+	int plevels[d + 1];
+	eval_task_t task;
+
+	for (pd = d; pd >= (type != GRID_BOUNDARY ? d : 0); pd--) {
+		zsize = Helper::zerob_size(pd, l);
+		/* the number of regular grids of one sparse grid */
+		cost = pd == 0 ? 1 : Helper::combi(pd - 1 + l, l - 1);
+		for (kk = 0; kk < (1 << (d - pd)) * Helper::combi(d, d - pd); kk++, index1 += zsize) {
+			if (cost > TASK_SUBSPACES) {
+				for (i = 0, pos = index1; i < l; i++)
+					pos = split_level(tasks, states, index1, pos, pd, plevels, pd, i, i);
+				run = 0;
+				continue;
+			}
+			if (run == 0 || run + cost > TASK_SUBSPACES) {
+				task.index1 = index1;
+				task.count = 0;
+				tasks.push_back(task);
+				run = 0;
+			}
+			tasks.back().count++;
+			run += cost;
+		}
+	}
+}
+
+/*
+ * the regular grids with the levels in the first prefix entries of plevels summing up to plevels[prefix - 1] (the
+ * other entries stay fixed), at the point pcoords; coefs are the coefficients of the first one
+ */
+static float evaluate_block(const float *coefs, const float *pcoords, float prod0, int pd, int *plevels, int prefix,
+		int level, GridType type)
+{
+	int k, t0, index2, rest = plevels[prefix - 1];
+	float val = 0.0f;
+
+	do {
+		val += hat_product(prod0, pcoords, plevels, pd, type, &index2) * coefs[index2];
+		coefs += 1 << level;
+
+		if (plevels[0] == rest)
+			break;
+
+		k = 1;
+		while (plevels[k] == 0)
+			k++;
+		plevels[k]--;
+		t0 = plevels[0];
+		plevels[0] = 0;
+		plevels[k - 1] = t0 + 1;
+	} while (1);
+
+	return val;
+}
+
+/* the contribution of one task at the point coords */
+static float evaluate_task(const float *sg1d, const eval_task_t &task, const int *states, const float *coords,
+		int d, int l, GridType type)
+{
+	int k, i, c, pd, pos, index1 = task.index1;
+	int levels[d], indices[d], plevels[d + 1];
+	float pcoords[d + 1], prod0, val = 0.0f;
+
+	for (c = 0; c < std::max(task.count, 1); c++) {
+		/* the boundary dimensions of the sparse grid give prod0, the others the point of its regular grids */
+		Converter::idx2gp(index1, levels, indices, d, l);
+		prod0 = 1.0f;
+		for (k = 0, pd = 0; k < d; k++) {
+			if (levels[k] == -1)
+				prod0 *= indices[k] == 0 ? 1 - coords[k] : coords[k];
+			else
+				pcoords[pd++] = coords[k];
+		}
+
+		if (task.count == 0) {
+			memcpy(plevels, states + task.state, pd * sizeof(int));
+
+			return evaluate_block(sg1d + task.pos, pcoords, prod0, pd, plevels, task.prefix, task.level, type);
+		}
+
+		if (pd == 0) {
+			val += prod0 * sg1d[index1];
+		} else {
+			for (i = 0, pos = index1; i < l; i++) {
+				memset(plevels, 0, pd * sizeof(int));
+				plevels[pd - 1] = i;
+				val += evaluate_block(sg1d + pos, pcoords, prod0, pd, plevels, pd, i, type);
+				pos += Helper::combi(pd - 1 + i, i) << i;
+			}
+		}
+		index1 += Helper::zerob_size(pd, l);
+	}
+
+	return val;
+}
+
+/* pool_task_t of a parallel single point evaluation */
+static void run_eval_task(int t, void *arg)
+{
+	eval_job_t *job = (eval_job_t *) arg;
+
+	job->partial[t] = evaluate_task(job->sg1d, job->tasks[t], job->states, job->coords, job->d, job->l, job->type);
+}
+
+/* evaluates one point with the threads of the shared pool stealing tasks from each other; see split_grid */
+float SparseGrid::evaluate(float *coords, int threads) const
+{
+	int i, pd;
+	size_t t;
+	long subspaces = 0;
+	float val = 0.0f;
+	std::vector<eval_task_t> tasks;
+	std::vector<int> states;
+	std::vector<float> partial;
+	eval_job_t job;
+
+	try {
+		for (i = 0; i < d; i++)
+			if (coords[i] > 1 || coords[i] < 0)
+				throw 1;
+	} catch (int i) {
+		std::cout << "The coordinates are not in [0,1]^d domain" << std::endl;
+
+		return 0.0f;
+	}
+	if (l < 1 || sg1d == NULL)
+		return evaluateLevels(coords, l);
+
+	/* a grid of less than one task is not worth waking up the pool */
+	for (pd = d; pd >= (type != GRID_BOUNDARY ? d : 0); pd--)
+		subspaces += (long) (1 << (d - pd)) * Helper::combi(d, d - pd) * (pd == 0 ? 1 : Helper::combi(pd - 1 + l, l - 1));
+	if (subspaces < TASK_SUBSPACES)
+		return evaluate(coords);
+
+	split_grid(d, l, type, tasks, states);
+	partial.assign(tasks.size(), 0.0f);
+	states.push_back(0);
+
+	job.sg1d = sg1d;
+	job.tasks = &tasks[0];
+	job.states = &states[0];
+	job.coords = coords;
+	job.partial = &partial[0];
+	job.d = d;
+	job.l = l;
+	job.type = type;
+	TaskPool::shared()->run(tasks.size(), threads, run_eval_task, &job);
+
+	/* the partial sums are added in task order, whichever thread computed them */
+	for (t = 0; t < tasks.size(); t++)
+		val += partial[t];
+
+	return val;
+}
+
+/* moves the coefficients to the NUMA nodes as required by policy */
+int SparseGrid::setNumaPolicy(NumaPolicy policy, int threads)
+{
+	int t, nodes = Numa::nodes();
+	std::atomic<int> status(0);
+	size_t bytes = numOfGridPoints * sizeof(float);
+	std::vector<std::thread> workers;
+	AllocKind b;
+	float *p;
+
+	releaseNuma();
+	numaPolicy = policy;
+	numaThreads = threads < 1 ? 1 : threads;
+
+	switch (policy) {
+	case NUMA_INTERLEAVE:
+		/* the policy must be set before the pages are touched by the copy */
+		p = (float *) allocator->allocate(bytes, &b);
+		if (p == NULL) {
+			numaPolicy = NUMA_NONE;
+			return -1;
+		}
+		if (Numa::interleave(p, bytes))
+			status = -1;
+		memcpy(p, sg1d, bytes);
+		releaseCoefficients();
+		sg1d = p;
+		backing = b;
+		break;
+
+	case NUMA_REPLICATE:
+		/* every copy is allocated and first touched by a thread running on its node */
+		replicas = (float **) calloc(nodes, sizeof(float *));
+		replicaBackings = (AllocKind *) calloc(nodes, sizeof(AllocKind));
+		for (t = 0; t < nodes; t++)
+			workers.push_back(std::thread([this, t, bytes, &status]() {
+				float *r = (float *) allocator->allocate(bytes, &replicaBackings[t]);
+
+				if (Numa::pin(t) || r == NULL || Numa::bind(r, bytes, t))
+					status = -1;
+				if (r != NULL)
+					memcpy(r, sg1d, bytes);
+				replicas[t] = r;
+			}));
+		for (t = 0; t < nodes; t++)
+			workers[t].join();
+		for (t = 0; t < nodes; t++)
+			if (replicas[t] == NULL) {
+				releaseNuma();
+				numaPolicy = NUMA_NONE;
+				return -1;
+			}
+		break;
+
+	case NUMA_PARTITION:
+		/* the range of each thread is first touched by a thread running where the evaluating thread will run */
+		ranges = (int *) malloc((numaThreads + 1) * sizeof(int));
+		Helper::partition(d, l, type, numaThreads, ranges);
+		p = (float *) allocator->allocate(bytes, &b);
+		if (p == NULL) {
+			releaseNuma();
+			numaPolicy = NUMA_NONE;
+			return -1;
+		}
+		for (t = 0; t < numaThreads; t++)
+			workers.push_back(std::thread([this, t, p, &status]() {
+				int node = numa_node(t, numaThreads);
+				size_t len = (ranges[t + 1] - ranges[t]) * sizeof(float);
+
+				if (Numa::pin(node) || (len > 0 && Numa::bind(p + ranges[t], len, node)))
+					status = -1;
+				memcpy(p + ranges[t], sg1d + ranges[t], len);
+			}));
+		for (t = 0; t < numaThreads; t++)
+			workers[t].join();
+		releaseCoefficients();
+		sg1d = p;
+		backing = b;
+		break;
+
+	default:
+		break;
+	}
+
+	return status.load();
+}
+
+/* returns the kind of memory holding the coefficients */
+AllocKind SparseGrid::getBacking() const
+{
+	return backing;
+}
+
+/* returns how many bytes of the coefficients are backed by huge pages */
+size_t SparseGrid::getHugePageBytes() const
+{
+	return Allocator::hugePageBytes(sg1d, numOfGridPoints * sizeof(float));
+}
+
+/* returns the NUMA policy */
+NumaPolicy SparseGrid::getNumaPolicy() const
+{
+	return numaPolicy;
+}
+
+void SparseGrid::releaseNuma()
+{
+	int i;
+
+	if (replicas != NULL) {
+		for (i = 0; i < Numa::nodes(); i++)
+			allocator->release(replicas[i], numOfGridPoints * sizeof(float), replicaBackings[i]);
+		free(replicas);
+		free(replicaBackings);
+		replicas = NULL;
+		replicaBackings = NULL;
+	}
+	free(ranges);
+	ranges = NULL;
+}
+
 /* 
  * computes the hierarchical coefficients for a d-dimesional, level n, non-0 boundary sparse grid
  * initially, sg1d contains function values 
  */
 int SparseGrid::hierarchize()
 {
-	int i, j;
-	float val1, val2;
-	int levels[d], indices[d];
-	int plevels[d], pindices[d];
-	float *sg1d = this->sg1d;
+	HierarchizationPlan plan(d, l, type);
+
+	return hierarchize(&plan);
+}
+
+int SparseGrid::hierarchize(const HierarchizationPlan *plan)
+{
+	int i;
+	FSG_INST(unsigned long long t_start = Instrumentation::nanoseconds();)
+
+	if (plan->getD() != d || plan->getL() != l || plan->getType() != type) {
+		std::cout << "The plan was made for another shape of sparse grid" << std::endl;
+		return -1;
+	}
+	plan->hierarchize(sg1d);
+
+	/* keep the per node copies in sync */
+	if (replicas != NULL)
+		for (i = 0; i < Numa::nodes(); i++)
+			memcpy(replicas[i], this->sg1d, numOfGridPoints * sizeof(float));
+
+	computeBounds();
+	hierarchized = 1;
+
+	FSG_INST(Instrumentation::addLatency(INST_OP_HIERARCHIZE, Instrumentation::nanoseconds() - t_start);)
+
+	return 0;
+}
+
+/*
+ * the candidates of every dimension are the 1-dimensional basis functions that do not vanish at the point (its own,
+ * the coarser ones whose support contains it and the boundary functions); a depth-first walk combines them and stops
+ * as soon as the level sum leaves the grid
+ */
+double SparseGrid::nodal(int *levels, int *indices) const
+{
+	int k, m, c, s, cell;
+	int n[d + 1], lv[d + 1][l + 3], ix[d + 1][l + 3], pl[d + 1], pi[d + 1], choice[d + 1], sums[d + 1];
+	double bv[d + 1][l + 3], prods[d + 1], val = 0.0;
+	float x;
+
+	if (d == 0)
+		return sg1d[0];
+
+	for (k = 0; k < d; k++) {
+		n[k] = 0;
+		if (levels[k] == -1) {
+			lv[k][0] = -1;
+			ix[k][0] = indices[k];
+			bv[k][0] = 1.0;
+			n[k] = 1;
+			continue;
+		}
+		x = (2 * indices[k] + 1) / (float) (2 << levels[k]);
+		for (m = 0; m <= levels[k]; m++) {
+			cell = 0;
+			if (type == GRID_MODIFIED) {
+				bv[k][n[k]] = Helper::modified_basis(x, m, &cell);
+			} else {
+				cell = (int) (x * (1 << m));
+				bv[k][n[k]] = 1.0 - fabs(2.0 * (x * (1 << m) - cell) - 1.0);
+			}
+			lv[k][n[k]] = m;
+			ix[k][n[k]++] = cell;
+		}
+		if (type == GRID_BOUNDARY)
+			for (c = 0; c < 2; c++) {
+				lv[k][n[k]] = -1;
+				ix[k][n[k]] = c;
+				bv[k][n[k]++] = c == 0 ? 1.0 - x : x;
+			}
+	}
+
+	k = 0;
+	choice[0] = -1;
+	sums[0] = 0;
+	prods[0] = 1.0;
+	while (k >= 0) {
+		if (++choice[k] == n[k]) {
+			k--;
+			continue;
+		}
+		c = choice[k];
+		s = sums[k] + (lv[k][c] == -1 ? 0 : lv[k][c]);
+		if (s >= l)
+			continue;
+		pl[k] = lv[k][c];
+		pi[k] = ix[k][c];
+		if (k == d - 1) {
+			val += prods[k] * bv[k][c] * sg1d[gp2idx(pl, pi)];
+			continue;
+		}
+		sums[k + 1] = s;
+		prods[k + 1] = prods[k] * bv[k][c];
+		choice[k + 1] = -1;
+		k++;
+	}
+
+	return val;
+}
+
+/*
+ * adds the hierarchization of the (sparse) change of the nodal values to the coefficients;
+ * the old nodal values are reconstructed from the coefficients of the changed points and their ancestors
+ */
+int SparseGrid::update(int *changed, float *values, int n)
+{
+	int i, j, k, cd, lsum, num;
+	int levels[d], indices[d], plevels[d], pindices[d], positions[2];
+	float weights[2];
+	std::map<int, double> delta, next;
+	std::map<int, double>::iterator it, p;
+
+	for (j = 0; j < n; j++)
+		if (changed[j] < 0 || changed[j] >= numOfGridPoints) {
+			std::cout << "The position " << changed[j] << " is not in the sparse grid" << std::endl;
+			return -1;
+		}
+
+	/* nodal values are simply replaced */
+	if (!hierarchized) {
+		for (j = 0; j < n; j++) {
+			sg1d[changed[j]] = values[j];
+			if (replicas != NULL)
+				for (i = 0; i < Numa::nodes(); i++)
+					replicas[i][changed[j]] = values[j];
+		}
+
+		return 0;
+	}
+
+	for (j = 0; j < n; j++) {
+		idx2gp(changed[j], levels, indices);
+		delta[changed[j]] = values[j] - nodal(levels, indices);
+	}
 
 	/* loop over dimensions */
-	for (i = 0; i < d; i++)
-		/* loop over grid points */
-		for (j = size(d, l) - 1; j >= 0; j--) {
-			/* convert index to (l, i) */
-			Converter::idx2gp(j, levels, indices, d, l);
-
-			/* retrieve left parent's value from sparse grid */
-			if (getLeftParent(levels, indices, plevels, pindices, i) != -1)
-				val1 = sg1d[Converter::gp2idx(plevels, pindices, d, l)];
-			else
-				val1 = 0;
+	for (cd = 0; cd < d; cd++) {
+		next.clear();
+
+		/* the changed points and the points whose direct parents in dimension cd are changed */
+		for (it = delta.begin(); it != delta.end(); ++it) {
+			next[it->first] = 0;
+			idx2gp(it->first, levels, indices);
+			for (i = 0, lsum = 0; i < d; i++)
+				if (i != cd && levels[i] != -1)
+					lsum += levels[i];
+
+			/* k = 0: children on the left (left child, then right children); k = 1: on the right */
+			for (k = 0; k < 2; k++) {
+				for (i = 0; i < d; i++) {
+					plevels[i] = levels[i];
+					pindices[i] = indices[i];
+				}
+				if (levels[cd] == -1) {
+					/* the left border is the left parent of the first point of every level, the right one of the last */
+					if (indices[cd] != 1 - k)
+						continue;
+					plevels[cd] = 0;
+					pindices[cd] = 0;
+				} else {
+					plevels[cd] = levels[cd] + 1;
+					pindices[cd] = 2 * indices[cd] + k;
+				}
+				for (; lsum + plevels[cd] < l; plevels[cd]++) {
+					next[gp2idx(plevels, pindices)] = 0;
+					pindices[cd] = 2 * pindices[cd] + 1 - k;
+				}
 
-			/* retrieve right parent's value from sparse grid */
-			if (getRightParent(levels, indices, plevels, pindices, i) != -1)
-				val2 = sg1d[Converter::gp2idx(plevels, pindices, d, l)];
-			else
-				val2 = 0;
-	
-			/* update current hierarchical coefficient (at position j) */
-			sg1d[j] = sg1d[j] - (val1 + val2) / 2.0f;
+				/* with the modified basis, the first (last) points of the next two levels extrapolate from it */
+				if (type == GRID_MODIFIED && indices[cd] == (k == 0 ? 0 : (1 << levels[cd]) - 1))
+					for (plevels[cd] = levels[cd] + 1; plevels[cd] <= levels[cd] + 2
+							&& lsum + plevels[cd] < l; plevels[cd]++) {
+						pindices[cd] = k == 0 ? 0 : (1 << plevels[cd]) - 1;
+						next[gp2idx(plevels, pindices)] = 0;
+					}
+			}
 		}
 
+		/* same update as in hierarchize, with the parents' changes (0 if they are not changed) */
+		for (it = next.begin(); it != next.end(); ++it) {
+			idx2gp(it->first, levels, indices);
+			if ((p = delta.find(it->first)) != delta.end())
+				it->second = p->second;
+			num = parents(levels, indices, cd, positions, weights);
+			for (k = 0; k < num; k++)
+				if ((p = delta.find(positions[k])) != delta.end())
+					it->second -= weights[k] * p->second;
+		}
+		delta.swap(next);
+	}
+
+	for (it = delta.begin(); it != delta.end(); ++it)
+		sg1d[it->first] += it->second;
+
+	/* keep the per node copies in sync */
+	if (replicas != NULL)
+		for (i = 0; i < Numa::nodes(); i++)
+			for (it = delta.begin(); it != delta.end(); ++it)
+				replicas[i][it->first] = sg1d[it->first];
+
+	/* the maxima can only grow; keeping the old ones where they shrink still gives valid bounds */
+	if (maxSurplus != NULL) {
+		for (it = delta.begin(); it != delta.end(); ++it) {
+			j = std::upper_bound(subspaceStart, subspaceStart + numSubspaces, it->first) - subspaceStart - 1;
+			maxSurplus[j] = std::max(maxSurplus[j], fabsf(sg1d[it->first]));
+		}
+		sumBounds();
+	}
+
 	return 0;
 }
 
+/*
+ * the inverse of hierarchize: coarse to fine, every point gets the interpolant of its parents back;
+ * the parents are restored before their children (lower position, or on the boundary in dimension i)
+ */
+int SparseGrid::dehierarchize()
+{
+	HierarchizationPlan plan(d, l, type);
+
+	return dehierarchize(&plan);
+}
+
+int SparseGrid::dehierarchize(const HierarchizationPlan *plan)
+{
+	int i;
+
+	if (plan->getD() != d || plan->getL() != l || plan->getType() != type) {
+		std::cout << "The plan was made for another shape of sparse grid" << std::endl;
+		return -1;
+	}
+	plan->dehierarchize(sg1d);
+
+	if (replicas != NULL)
+		for (i = 0; i < Numa::nodes(); i++)
+			memcpy(replicas[i], sg1d, numOfGridPoints * sizeof(float));
+
+	hierarchized = 0;
+
+	return 0;
+}
+
+/*
+ * the level l grid is nested in the level l + 1 grid: the interior layouts just grow at the end, the
+ * non-0 boundary layout is remapped point by point with the Converter bijection
+ */
+int SparseGrid::refineLevel(Function *f, int threads)
+{
+	int i, t, size, wasHierarchized = hierarchized;
+	NumaPolicy policy = numaPolicy;
+	std::vector<char> sampled;
+	std::vector<int> missing;
+	std::vector<std::thread> workers;
+	std::atomic<int> next(0);
+	AllocKind b;
+	float *p;
+
+	if (f->getD() != d) {
+		std::cout << "The function does not have the dimensionality of the sparse grid" << std::endl;
+		return -1;
+	}
+
+	size = type != GRID_BOUNDARY ? Helper::zerob_size(d, l + 1) : this->size(d, l + 1);
+	p = (float *) allocator->allocate(size * sizeof(float), &b);
+	if (p == NULL)
+		return -1;
+
+	releaseNuma();
+	releaseBounds();
+
+	/* the old values are moved first, so that a wrapped buffer is left as it is; the new points get a zero
+	   coefficient, which makes the level l + 1 dehierarchization below give the nodal values of the old ones */
+	memset(p, 0, size * sizeof(float));
+	sampled.assign(size, 0);
+	if (type != GRID_BOUNDARY) {
+		memcpy(p, sg1d, numOfGridPoints * sizeof(float));
+		memset(&sampled[0], 1, numOfGridPoints);
+	} else {
+		int levels[d], indices[d], pos;
+
+		for (i = 0; i < numOfGridPoints; i++) {
+			Converter::idx2gp(i, levels, indices, d, l);
+			pos = Converter::gp2idx(levels, indices, d, l + 1);
+			p[pos] = sg1d[i];
+			sampled[pos] = 1;
+		}
+	}
+
+	releaseCoefficients();
+	sg1d = p;
+	backing = b;
+	numOfGridPoints = size;
+	l++;
+	if (wasHierarchized)
+		dehierarchize();
+
+	/* the new points, handed out one by one since the samples may take very different times */
+	for (i = 0; i < size; i++)
+		if (!sampled[i])
+			missing.push_back(i);
+	for (t = 0; t < (threads < 1 ? 1 : threads); t++)
+		workers.push_back(std::thread([this, f, &missing, &next]() {
+			float gp[d];
+			int k;
+
+			while ((k = next++) < (int) missing.size()) {
+				if (type != GRID_BOUNDARY)
+					Converter::zb_idx2gp(missing[k], gp, d);
+				else
+					Converter::idx2gp(missing[k], gp, d, l);
+				sg1d[missing[k]] = f->getValue(gp);
+			}
+		}));
+	for (t = 0; t < (int) workers.size(); t++)
+		workers[t].join();
+
+	if (wasHierarchized)
+		hierarchize();
+	if (policy != NUMA_NONE)
+		setNumaPolicy(policy, numaThreads);
+
+	return 0;
+}
+
+/*
+ * the surpluses of the subspaces of level sum < level do not depend on the finer ones, so they are the
+ * coefficients of the coarse grid; every sparse grid keeps the beginning of its block
+ */
+SparseGrid *SparseGrid::coarsen(int level)
+{
+	int pd, kk, from = 0, to = 0, zsize, csize;
+	SparseGrid *coarse;
+
+	if (level < 0 || level > l || !hierarchized) {
+		std::cout << "Only a hierarchized grid can be coarsened, to a level between 0 and " << l << std::endl;
+		return NULL;
+	}
+
+	coarse = new SparseGrid(d, level, type, allocator);
+	if (coarse->sg1d == NULL) {
+		delete coarse;
+		return NULL;
+	}
+
+	for (pd = d; pd >= (type != GRID_BOUNDARY ? d : 0); pd--) {
+		zsize = Helper::zerob_size(pd, l);
+		csize = Helper::zerob_size(pd, level);
+		for (kk = 0; kk < (1 << (d - pd)) * Helper::combi(d, d - pd); kk++) {
+			memcpy(coarse->sg1d + to, sg1d + from, csize * sizeof(float));
+			from += zsize;
+			to += csize;
+		}
+	}
+
+	coarse->reorderMin = reorderMin;
+	coarse->hierarchized = 1;
+	coarse->computeBounds();
+
+	return coarse;
+}
+
+/* integral over [0, 1] of the 1-dimensional basis function (level, index) */
+static double basis_integral(int level, int index, GridType type)
+{
+	/* the boundary functions 1 - x and x */
+	if (level == -1)
+		return 0.5;
+
+	if (type == GRID_MODIFIED) {
+		/* the constant, and the functions next to the boundary, going up to 2 over twice the hat's width */
+		if (level == 0)
+			return 1.0;
+		if (index == 0 || index == (1 << level) - 1)
+			return 1.0 / (1 << level);
+	}
+
+	/* hat of height 1 and width 2^-level */
+	return 1.0 / (1 << (level + 1));
+}
+
+/* value at x of the 1-dimensional basis function (level, index) */
+static double basis_value(int level, int index, float x, GridType type)
+{
+	int cell = 0;
+	float val;
+
+	if (level == -1)
+		return index == 0 ? 1 - x : x;
+
+	/* the support of a basis function is its cell */
+	if (type == GRID_MODIFIED) {
+		val = Helper::modified_basis(x, level, &cell);
+		return cell == index ? val : 0.0;
+	}
+
+	return std::max(0.0f, 1.0f - fabsf(2.0f * (x * (1 << level) - index) - 1.0f));
+}
+
+SparseGrid *SparseGrid::marginalize(int *mask)
+{
+	if (!hierarchized) {
+		std::cout << "Only a hierarchized grid can be marginalized" << std::endl;
+		return NULL;
+	}
+
+	return project(mask, NULL);
+}
+
+SparseGrid *SparseGrid::slice(int *mask, float *values)
+{
+	int k;
+
+	if (!hierarchized) {
+		std::cout << "Only a hierarchized grid can be sliced" << std::endl;
+		return NULL;
+	}
+	for (k = 0; k < d; k++)
+		if (mask[k] && (values[k] < 0 || values[k] > 1)) {
+			std::cout << "The coordinates are not in [0,1]^d domain" << std::endl;
+			return NULL;
+		}
+
+	return project(mask, values);
+}
+
+/*
+ * f(x) = sum over the points p of coef(p) * prod_k phi_p,k(x_k); integrating out or fixing a dimension replaces
+ * its factor by the integral or the value of the basis function. The point of the new grid keeps the (l, i) of
+ * the other dimensions, whose level sum is not larger, so it is a grid of the same level and kind.
+ */
+SparseGrid *SparseGrid::project(int *mask, float *values)
+{
+	int i, j, k, m = 0, pos;
+	int levels[d], indices[d], mlevels[d], mindices[d];
+	double weight;
+	std::vector<double> sums;
+	SparseGrid *grid;
+
+	for (k = 0; k < d; k++)
+		if (!mask[k])
+			m++;
+
+	grid = new SparseGrid(m, l, type, allocator);
+	if (grid->sg1d == NULL) {
+		delete grid;
+		return NULL;
+	}
+
+	/* one pass over the coefficients, summed in double precision */
+	sums.assign(grid->numOfGridPoints, 0.0);
+	for (j = 0; j < numOfGridPoints; j++) {
+		idx2gp(j, levels, indices);
+		weight = sg1d[j];
+		for (k = 0, i = 0; k < d; k++) {
+			if (mask[k]) {
+				weight *= values == NULL ? basis_integral(levels[k], indices[k], type)
+						: basis_value(levels[k], indices[k], values[k], type);
+			} else {
+				mlevels[i] = levels[k];
+				mindices[i++] = indices[k];
+			}
+		}
+		/* most points do not contribute to a slice */
+		if (weight == 0.0)
+			continue;
+		pos = m > 0 ? grid->gp2idx(mlevels, mindices) : 0;
+		sums[pos] += weight;
+	}
+
+	for (j = 0; j < grid->numOfGridPoints; j++)
+		grid->sg1d[j] = sums[j];
+	grid->hierarchized = 1;
+	grid->computeBounds();
+
+	return grid;
+}
+
+/* frees the subspace table and the bounds */
+void SparseGrid::releaseBounds()
+{
+	free(subspaceStart);
+	free(subspaceLevel);
+	free(maxSurplus);
+	free(levelBounds);
+	subspaceStart = subspaceLevel = NULL;
+	maxSurplus = levelBounds = NULL;
+	numSubspaces = 0;
+}
+
+/* max |coefficient| of every subspace; the subspaces are located the first time */
+void SparseGrid::computeBounds()
+{
+	int pass, pd, kk, i, c, s, pos, j;
+
+	if (subspaceStart == NULL) {
+		/* the first pass counts the subspaces, the second one records where they start */
+		for (pass = 0; pass < 2; pass++) {
+			s = pos = 0;
+			for (pd = d; pd >= (type != GRID_BOUNDARY ? d : 0); pd--)
+				for (kk = 0; kk < (1 << (d - pd)) * Helper::combi(d, d - pd); kk++) {
+					/* a 0-dimensional sparse grid is a single point, counted as level 0 */
+					for (i = 0; i < (pd == 0 ? 1 : l); i++)
+						for (c = 0; c < (pd == 0 ? 1 : Helper::combi(pd - 1 + i, i)); c++, s++) {
+							if (pass == 1) {
+								subspaceStart[s] = pos;
+								subspaceLevel[s] = i;
+							}
+							pos += 1 << i;
+						}
+				}
+			if (pass == 0) {
+				numSubspaces = s;
+				subspaceStart = (int *) malloc((s + 1) * sizeof(int));
+				subspaceLevel = (int *) malloc((s + 1) * sizeof(int));
+				maxSurplus = (float *) malloc((s + 1) * sizeof(float));
+				levelBounds = (float *) malloc((l + 1) * sizeof(float));
+			} else {
+				subspaceStart[s] = pos;
+			}
+		}
+	}
+
+	for (s = 0; s < numSubspaces; s++) {
+		maxSurplus[s] = 0.0f;
+		for (j = subspaceStart[s]; j < subspaceStart[s + 1]; j++)
+			maxSurplus[s] = std::max(maxSurplus[s], fabsf(sg1d[j]));
+	}
+
+	sumBounds();
+}
+
+/*
+ * levelBounds[i] = sum of maxSurplus over the subspaces of level sum i or more, scaled by the largest basis
+ * function value (2^(dimensions of level >= 1) for the modified basis; there are at most min(d, i) of them)
+ */
+void SparseGrid::sumBounds()
+{
+	int s, i;
+
+	for (i = 0; i <= l; i++)
+		levelBounds[i] = 0.0f;
+	for (s = 0; s < numSubspaces; s++)
+		levelBounds[subspaceLevel[s]] += maxSurplus[s]
+				* (type == GRID_MODIFIED ? 1 << std::min(d, subspaceLevel[s]) : 1);
+	for (i = l - 1; i >= 0; i--)
+		levelBounds[i] += levelBounds[i + 1];
+}
+
+/*
+ * the number of level sums to evaluate: at most maxLevel, fewer if the skipped ones stay within tol.
+ * In a subspace only one basis function is non-zero at any point and it is at most 1, so a skipped
+ * subspace changes the result by at most its max |coefficient| (modified basis functions reach 2 in
+ * every dimension of level 1 or more, see sumBounds).
+ */
+int SparseGrid::cutLevel(int maxLevel, float tol, float *bound) const
+{
+	int cut = std::max(0, std::min(maxLevel, l));
+
+	if (levelBounds == NULL) {
+		/* not hierarchized yet: nothing is known about the coefficients */
+		if (bound != NULL)
+			*bound = cut < l ? HUGE_VALF : 0.0f;
+
+		return cut;
+	}
+
+	while (tol >= 0 && cut > 0 && levelBounds[cut - 1] <= tol)
+		cut--;
+	if (bound != NULL)
+		*bound = levelBounds[cut];
+
+	return cut;
+}
+
+/*
+ * the interpolant of the coarser levels: the mean of the left and right parents; with the modified basis the
+ * coarser levels extrapolate linearly next to the boundary (from the two closest points) and level 1 sees the
+ * constant of level 0
+ */
+int SparseGrid::parents(int *levels, int *indices, int cd, int *positions, float *weights)
+{
+	int i, num = 0, lv = levels[cd];
+	int plevels[d], pindices[d];
+
+	if (type == GRID_MODIFIED && lv >= 1 && (indices[cd] == 0 || indices[cd] == (1 << lv) - 1)) {
+		for (i = 0; i < d; i++) {
+			plevels[i] = levels[i];
+			pindices[i] = indices[i];
+		}
+		for (i = 1; i <= std::min(lv, 2); i++) {
+			plevels[cd] = lv - i;
+			pindices[cd] = indices[cd] == 0 ? 0 : (1 << (lv - i)) - 1;
+			positions[num] = gp2idx(plevels, pindices);
+			weights[num++] = lv == 1 ? 1.0f : (i == 1 ? 1.5f : -0.5f);
+		}
+
+		return num;
+	}
+
+	if (getLeftParent(levels, indices, plevels, pindices, cd) != -1
+			&& (positions[num] = gp2idx(plevels, pindices)) != -1)
+		weights[num++] = 0.5f;
+	if (getRightParent(levels, indices, plevels, pindices, cd) != -1
+			&& (positions[num] = gp2idx(plevels, pindices)) != -1)
+		weights[num++] = 0.5f;
+
+	return num;
+}
+
 /* returns the (l, i) of the left parent in dimension cd */
 int SparseGrid::getLeftParent(int *levels, int *indices, int *plevels, int *pindices, int cd)
 {
@@ -416,6 +1768,9 @@ int SparseGrid::next(int *crt_levels, int *crt_indices, int *next_levels, int *n
 	int index = Converter::gp2idx(crt_levels, crt_indices, d, l);
 	int i, pd = 0;
 
+	if (type != GRID_BOUNDARY)
+		return -1;
+
 	for (i = 0; i < d; i++)
 		if (crt_levels[i] != -1)
 			pd++;
@@ -440,6 +1795,38 @@ int SparseGrid::size(int d, int n)
 	return s;
 }
 
+/* converted in chunks with the bulk (vectorized) conversions */
+int SparseGrid::coordinates(int d, int l, GridType type, float *coords)
+{
+	int i, j, num, total, chunk = 4096;
+
+	if (d < 0 || l < 0)
+		return -1;
+	total = type != GRID_BOUNDARY ? Helper::zerob_size(d, l) : size(d, l);
+
+	if (type != GRID_BOUNDARY) {
+		for (i = 0; i < total; i++)
+			Converter::zb_idx2gp(i, coords + (long) i * d, d);
+		return 0;
+	}
+
+	std::vector<int> idx(chunk), levels(chunk * d + 1), indices(chunk * d + 1);
+	for (i = 0; i < total; i += chunk) {
+		num = std::min(chunk, total - i);
+		for (j = 0; j < num; j++)
+			idx[j] = i + j;
+		Converter::bulk_idx2gp(&idx[0], num, &levels[0], &indices[0], d, l);
+		Converter::bulk_li2coord(&levels[0], &indices[0], num, coords + (long) i * d, d);
+	}
+
+	return 0;
+}
+
+int SparseGrid::getCoordinates(float *coords) const
+{
+	return coordinates(d, l, type, coords);
+}
+
 /* returns the size of the sparse grid */
 int SparseGrid::size() const
 {
@@ -447,14 +1834,44 @@ int SparseGrid::size() const
 }
 
 /* returns the number of dimensions */
-int SparseGrid::getD()
+int SparseGrid::getD() const
 {
 	return d;
 }
 
 /* returns the refinement level */
-int SparseGrid::getL()
+int SparseGrid::getL() const
 {
 	return l;
 }
 
+/* returns the kind of the sparse grid */
+GridType SparseGrid::getType() const
+{
+	return type;
+}
+
+/* position of the grid point (levels, indices) in sg1d; -1 if the point is not stored */
+int SparseGrid::gp2idx(int *levels, int *indices) const
+{
+	int i;
+
+	if (type != GRID_BOUNDARY) {
+		for (i = 0; i < d; i++)
+			if (levels[i] == -1)
+				return -1;
+
+		return Converter::zb_gp2idx(levels, indices, d);
+	}
+
+	return Converter::gp2idx(levels, indices, d, l);
+}
+
+/* (l, i) of the grid point stored at position index in sg1d */
+void SparseGrid::idx2gp(int index, int *levels, int *indices) const
+{
+	if (type != GRID_BOUNDARY)
+		Converter::zb_idx2gp(index, levels, indices, d);
+	else
+		Converter::idx2gp(index, levels, indices, d, l);
+}
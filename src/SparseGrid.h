@@ -23,6 +23,9 @@
  *
  *********************************************************************************/
 
+#include <stddef.h>
+
+#include "Allocator.h"
 #include "DataStructure.h"
 #include "Function.h"
 
@@ -31,6 +34,30 @@
 
 namespace fsg
 {
+	/* kinds of sparse grids */
+	enum GridType {
+		GRID_BOUNDARY = 0,	/* non-0 boundary sparse grid (3^d groups of 0-boundary sparse grids) */
+		GRID_ZERO_BOUNDARY,	/* the function is 0 on the boundary, only the interior points are stored */
+		GRID_MODIFIED		/* only the interior points are stored (as for GRID_ZERO_BOUNDARY); the basis
+					   functions next to the boundary extrapolate linearly towards it, level 0 is constant */
+	};
+
+	/* placement of the coefficients on NUMA systems, see SparseGrid::setNumaPolicy */
+	enum NumaPolicy {
+		NUMA_NONE = 0,		/* wherever malloc and the constructor thread put them */
+		NUMA_INTERLEAVE,	/* pages interleaved over all nodes; the points are split among the threads */
+		NUMA_REPLICATE,		/* one read-only copy per node; the points are split among the threads */
+		NUMA_PARTITION		/* one range of subspaces per thread, placed on the node of the thread */
+	};
+
+	/* how a grid built from nodal values holds them */
+	enum BufferMode {
+		BUFFER_COPY = 0,	/* the values are copied into memory from the allocator */
+		BUFFER_WRAP		/* the values are used in place; the caller keeps the buffer and its ownership */
+	};
+
+	class HierarchizationPlan;
+
 	/**
 	* @class SparseGrid
 	*
@@ -48,20 +75,52 @@ namespace fsg
 			 * Class constructor
 			 * @param l Level of refinement
 			 * @param f Function to be represented using the sparse grid technique
+			 * @param type GRID_BOUNDARY, GRID_ZERO_BOUNDARY (f is assumed to be 0 on the boundary
+			 * and only the Helper::zerob_size(d, l) interior points are sampled and stored) or GRID_MODIFIED
+			 * (the same interior points, with the modified linear basis; f need not vanish on the boundary)
+			 * @param allocator Provides the memory for the coefficients (NULL for malloc); it must outlive the grid
+			 */
+			SparseGrid(int l, Function* f, GridType type = GRID_BOUNDARY, Allocator *allocator = NULL);
+
+			/**
+			 * Class constructor for nodal values computed elsewhere, e.g. in bulk at the points given by coordinates
+			 * @param d Number of dimensions
+			 * @param l Level of refinement
+			 * @param values The function values at the grid points, in sg1d order (see coordinates)
+			 * @param type GRID_BOUNDARY, GRID_ZERO_BOUNDARY or GRID_MODIFIED
+			 * @param mode BUFFER_COPY or BUFFER_WRAP. A wrapped buffer is not copied and not freed: it must outlive
+			 * the grid, and hierarchize (or update) change it in place. refineLevel and the NUMA policies that move
+			 * the coefficients leave it for memory from the allocator.
+			 * @param allocator Provides the memory for the coefficients (NULL for malloc); it must outlive the grid
 			 */
-			SparseGrid(int l, Function* f);
+			SparseGrid(int d, int l, float *values, GridType type = GRID_BOUNDARY, BufferMode mode = BUFFER_COPY,
+					Allocator *allocator = NULL);
 
 			/**
 			 * Class destructor
 			 */
 			virtual ~SparseGrid();
 
+			/**
+			 * Move constructor; other hands over its coefficients and is left empty (size 0): it may only be
+			 * destroyed or assigned to
+			 * @param other The grid to take over
+			 */
+			SparseGrid(SparseGrid &&other);
+
+			/**
+			 * Move assignment; the coefficients of this grid are released first
+			 * @param other The grid to take over, left empty
+			 * @return This grid
+			 */
+			SparseGrid &operator=(SparseGrid &&other);
+
 			/**
 			 * @param coords The point at which we evaluate (interpolate) the sparse grid
 			 * Evaluates (or interpolates) the sparse grid at point coords inside the [0, 1]^d domain
 			 * @return The result of the evaluation
 			 */
-			float evaluate(float *coords);
+			float evaluate(float *coords) const;
 
 			/**
 			 * @param coords The set of points at which we evaluate (interpolate) the sparse grid
@@ -70,7 +129,105 @@ namespace fsg
 			 * Evaluates (or interpolates) the sparse grid at points stored in coords inside the [0, 1]^d domain
 			 * @return Returns 0 if successfull
 			 */
-			int evaluate(float *coords, int n, float *vals);
+			int evaluate(float *coords, int n, float *vals) const;
+
+			/**
+			 * @param coords The set of points at which we evaluate (interpolate) the sparse grid
+			 * @param n The size of the set
+			 * @param vals The results of the evaluation
+			 * @param threads Number of threads (ignored with NUMA_PARTITION, which uses the threads given to setNumaPolicy)
+			 * Multi-threaded version of evaluate(coords, n, vals); the threads are pinned to the nodes that hold
+			 * the coefficients they read, according to the NUMA policy
+			 * @return Returns 0 if successfull
+			 */
+			int evaluate(float *coords, int n, float *vals, int threads) const;
+
+			/**
+			 * Evaluates one point with several threads, for large grids where a single query takes long. The
+			 * sparse grids are cut into tasks of at most a few hundred subspaces (whole small sparse grids, or blocks
+			 * of the regular grids of a large one), run by the persistent workers of TaskPool::shared(): every thread
+			 * starts with an equal share of the tasks and steals from the others when done. The partial sums are
+			 * added in task order, so the result does not depend on the number of threads or on the scheduling (it
+			 * may differ from evaluate(coords) in the last bits). While the pool serves the query of another thread,
+			 * the calling thread runs all the tasks itself. A grid of less than 512 subspaces, one task, is simply
+			 * evaluated by evaluate(coords).
+			 * @param coords The point at which we evaluate (interpolate) the sparse grid
+			 * @param threads The number of threads, the calling one included
+			 * @return The result of the evaluation
+			 */
+			float evaluate(float *coords, int threads) const;
+
+			/**
+			 * Evaluates the sparse grid on the lattice axes[0] x .. x axes[d - 1] by sum factorization: dimension 0
+			 * is contracted with the 1-dimensional basis matrices (one non-zero per row) once for every group of
+			 * subspaces sharing the levels of dimensions 1 .. d - 1, the partial sums of the group are added up and
+			 * contracted along dimension 1, and so on; the last dimension is contracted straight into vals. There are
+			 * no per point hat products or index computations.
+			 * @param axes The coordinates along each dimension, inside [0, 1]
+			 * @param sizes The number of coordinates along each dimension
+			 * @param vals The results, sizes[0] x .. x sizes[d - 1] in row-major order (the last dimension varies fastest)
+			 * @return Returns 0 if successfull
+			 */
+			int evaluateTensor(float **axes, int *sizes, float *vals) const;
+
+			/**
+			 * Level-truncated evaluation: only the subspaces whose level sum is below maxLevel are evaluated, and
+			 * fewer if the skipped ones are known to change the result by at most tol. The bound comes from the
+			 * max |coefficient| of every subspace, recorded by hierarchize.
+			 * @param coords The point at which we evaluate (interpolate) the sparse grid
+			 * @param maxLevel Number of level sums to evaluate at most (getL() for all of them)
+			 * @param tol Largest acceptable error caused by the truncation (negative to always use maxLevel)
+			 * @param bound Receives an upper bound of the difference to the full evaluation (may be NULL)
+			 * @return The result of the truncated evaluation
+			 */
+			float evaluate(float *coords, int maxLevel, float tol, float *bound) const;
+
+			/**
+			 * Level-truncated version of evaluate(coords, n, vals); the bound holds for every point
+			 * @param coords The set of points at which we evaluate (interpolate) the sparse grid
+			 * @param n The size of the set
+			 * @param vals The results of the evaluation
+			 * @param maxLevel Number of level sums to evaluate at most
+			 * @param tol Largest acceptable error caused by the truncation (negative to always use maxLevel)
+			 * @param bound Receives an upper bound of the difference to the full evaluation (may be NULL)
+			 * @return Returns 0 if successfull
+			 */
+			int evaluate(float *coords, int n, float *vals, int maxLevel, float tol, float *bound) const;
+
+			/**
+			 * Makes the batch evaluation sort the points along a Morton curve first (the results are returned
+			 * in the caller's order). Nearby points then reuse the coefficients of the finer levels while
+			 * they are still in cache; it pays off for large batches on grids that do not fit in cache.
+			 * @param minPoints Smallest batch to reorder; 0 disables reordering (default), -1 reorders the
+			 * batches of at least 128 points if the coefficients take more than 256 KB
+			 */
+			void setReordering(int minPoints);
+
+			/**
+			 * Moves the coefficients according to a NUMA policy. NUMA_REPLICATE copies are refreshed by hierarchize,
+			 * so they should only be used for serving a grid that is no longer modified otherwise.
+			 * @param policy The placement of the coefficients
+			 * @param threads Number of threads of the multi-threaded evaluation (used by NUMA_PARTITION)
+			 * @return Returns 0 if successful, -1 if the placement could not be enforced (the memory was only
+			 * first-touched by threads pinned to the intended nodes)
+			 */
+			int setNumaPolicy(NumaPolicy policy, int threads);
+
+			/**
+			 * @return The current NUMA policy
+			 */
+			NumaPolicy getNumaPolicy() const;
+
+			/**
+			 * The kind of memory the allocator actually provided (it may be weaker than the requested one)
+			 * @return The backing of the coefficients
+			 */
+			AllocKind getBacking() const;
+
+			/**
+			 * @return The number of bytes of the coefficients currently backed by huge pages
+			 */
+			size_t getHugePageBytes() const;
 
 			/**
 			 * Computes the hierarchical coefficients for a d-dimesional, level n, non-0 boundary sparse grid.
@@ -79,6 +236,82 @@ namespace fsg
 			 */
 			int hierarchize();
 
+			/**
+			 * Computes the hierarchical coefficients with a plan made for the shape of this grid, so the pole
+			 * schedule is not recomputed; a plan can be shared by all grids of the same (d, l, type)
+			 * @param plan The plan
+			 * @return Returns 0 if successful, -1 if the plan was made for another shape
+			 */
+			int hierarchize(const HierarchizationPlan *plan);
+
+			/**
+			 * Replaces the nodal values of some grid points of a hierarchized sparse grid. Hierarchization is
+			 * linear, so only the hierarchization of the change is added: it is non-zero at the changed points
+			 * and at their descendants that have one of them (or one of those descendants) as direct parent.
+			 * The work grows with the number of these points, not with the size of the grid. The old nodal
+			 * values come from the coefficients of the changed points and their hierarchical ancestors, and the
+			 * change is propagated in double. A grid that still holds nodal values just gets the new values.
+			 * @param changed Positions of the changed grid points in the sparse grid
+			 * @param values The new function values at these points
+			 * @param n Number of changed points
+			 * @return Returns 0 if successful, -1 if a position is not in the sparse grid
+			 */
+			int update(int *changed, float *values, int n);
+
+			/**
+			 * Turns the hierarchical coefficients back into the function values at the grid points
+			 * (the inverse of hierarchize)
+			 * @return Returns 0 if successful
+			 */
+			int dehierarchize();
+
+			/**
+			 * Turns the hierarchical coefficients back into function values with a plan (see hierarchize)
+			 * @param plan The plan
+			 * @return Returns 0 if successful, -1 if the plan was made for another shape
+			 */
+			int dehierarchize(const HierarchizationPlan *plan);
+
+			/**
+			 * Grows the grid from level l to l + 1. The values of the existing points are moved to their
+			 * positions in the level l + 1 layout and f is only sampled at the new points. A hierarchized
+			 * grid is dehierarchized in the new layout and hierarchized again at the end; a NUMA policy is
+			 * applied again. The old coefficients are not changed, so a wrapped buffer keeps its values.
+			 * @param f The function the grid was built from (called concurrently if threads > 1)
+			 * @param threads Number of threads sampling f
+			 * @return Returns 0 if successful, -1 if f does not match the grid or memory is exhausted
+			 */
+			int refineLevel(Function *f, int threads = 1);
+
+			/**
+			 * A lower level copy of a hierarchized grid, made of the coefficients of the subspaces of level sum
+			 * below level (one sequential pass, f is not needed). It uses the same allocator and is hierarchized.
+			 * @param level Level of the copy, at most getL()
+			 * @return The new grid (to be deleted by the caller), NULL if the grid is not hierarchized or level is
+			 * out of range
+			 */
+			SparseGrid *coarsen(int level);
+
+			/**
+			 * The marginal of a hierarchized grid: the integral over [0, 1] of the selected dimensions, as a grid of
+			 * the remaining dimensions (same level and kind). The basis functions of the integrated dimensions are
+			 * integrated analytically, so the result is exact for the interpolant; one pass, f is not needed.
+			 * @param mask One entry per dimension, non-zero for the dimensions integrated out
+			 * @return The new grid (to be deleted by the caller), NULL if the grid is not hierarchized
+			 */
+			SparseGrid *marginalize(int *mask);
+
+			/**
+			 * The restriction of a hierarchized grid to fixed values of the selected dimensions, as a grid of the
+			 * remaining dimensions (same level and kind). The 1-dimensional basis functions of the fixed dimensions
+			 * are evaluated once and folded into the coefficients; the slice is exact for the interpolant.
+			 * @param mask One entry per dimension, non-zero for the fixed dimensions
+			 * @param values One entry per dimension, the value of each fixed dimension (the others are ignored)
+			 * @return The new grid (to be deleted by the caller), NULL if the grid is not hierarchized or a value
+			 * is outside [0, 1]
+			 */
+			SparseGrid *slice(int *mask, float *values);
+
 			/**
 			 * @param levels The l vector of the child
 			 * @param indices The i vector of the child
@@ -125,7 +358,7 @@ namespace fsg
 			 * @param next_levels
 			 * @param next_indices
 			 * Returns the (l, i) pair corresponding to the beginning of the next sparse grid
-			 * @return Returns 0 if successful
+			 * @return Returns 0 if successful, -1 for 0-boundary and modified grids (they consist of a single sparse grid)
 			 */
 			int next(int *crt_levels, int *crt_indices, int *next_levels, int *next_indices);
 
@@ -147,18 +380,149 @@ namespace fsg
 			 * The number of dimensions of the sparse grid
 			 * @return The dimensionality of the sparse grid
 			 */			
-			int getD();
+			int getD() const;
+
+			/**
+			 * The coordinates of all grid points of a sparse grid, in sg1d order, to compute the nodal values in bulk
+			 * @param d Number of dimensions
+			 * @param l Level of refinement
+			 * @param type GRID_BOUNDARY, GRID_ZERO_BOUNDARY or GRID_MODIFIED
+			 * @param coords Receives the points (size x d, row-major)
+			 * @return Returns 0 if successful
+			 */
+			static int coordinates(int d, int l, GridType type, float *coords);
+
+			/**
+			 * The coordinates of the grid points of this grid; see coordinates
+			 * @param coords Receives the points (size() x d, row-major)
+			 * @return Returns 0 if successful
+			 */
+			int getCoordinates(float *coords) const;
 
 			/**
 			 * The refinement level of the sparse grid
 			 * @return The refinement level of the sparse grid
 			 */			
-			int getL();
+			int getL() const;
+
+			/**
+			 * The kind of the sparse grid
+			 * @return GRID_BOUNDARY, GRID_ZERO_BOUNDARY or GRID_MODIFIED
+			 */
+			GridType getType() const;
 			
 		private:
+			/* grids are not copied (the coefficients may take gigabytes); see SharedSparseGrid for sharing one */
+			SparseGrid(const SparseGrid &);
+			SparseGrid &operator=(const SparseGrid &);
+
+			/**
+			 * Takes over all members of other and leaves it empty; the members of this grid must hold nothing
+			 */
+			void take(SparseGrid &other);
+
+			/**
+			 * Constructor of a grid with uninitialized coefficients, or over a buffer of the caller if one is given
+			 */
+			SparseGrid(int d, int l, GridType type, Allocator *allocator, float *buffer = NULL);
+
+			/**
+			 * Releases sg1d unless it belongs to the caller
+			 */
+			void releaseCoefficients();
+
+			/**
+			 * @param levels The l vector of a grid point
+			 * @param indices The i vector of a grid point
+			 * @return The position of the point in sg1d, -1 if the point is not stored (boundary of a 0-boundary grid)
+			 */
+			int gp2idx(int *levels, int *indices) const;
+
+			/**
+			 * @param index A position in sg1d
+			 * @param levels The computed l vector
+			 * @param indices The computed i vector
+			 */
+			void idx2gp(int index, int *levels, int *indices) const;
+
+			/**
+			 * The function value at a grid point, from the coefficients of the point and of its hierarchical
+			 * ancestors (the basis functions that do not vanish there), summed up in double
+			 * @param levels The l vector of the grid point
+			 * @param indices The i vector of the grid point
+			 * @return The nodal value
+			 */
+			double nodal(int *levels, int *indices) const;
+
+			/**
+			 * The coarser points whose nodal values make up the interpolant of the coarser levels at a grid point
+			 * in dimension cd; its hierarchical coefficient is its value minus the weighted sum of theirs
+			 * @param levels The l vector of the grid point
+			 * @param indices The i vector of the grid point
+			 * @param cd The hierarchized dimension
+			 * @param positions Receives the positions of the (at most 2) parents in sg1d
+			 * @param weights Receives their weights
+			 * @return The number of parents
+			 */
+			int parents(int *levels, int *indices, int cd, int *positions, float *weights);
+
+			/**
+			 * Frees the NUMA replicas and ranges
+			 */
+			void releaseNuma();
+
+			/**
+			 * Evaluation restricted to the subspaces of level sum i < cut
+			 */
+			float evaluateLevels(float *coords, int cut) const;
+			int evaluateLevels(float *coords, int n, float *vals, int cut) const;
+
+			/**
+			 * evaluateLevels with the points in Morton order, if reordering is enabled for this batch
+			 */
+			int evaluateOrdered(float *coords, int n, float *vals, int cut) const;
+
+			/**
+			 * Records the max |coefficient| of every subspace and the per level sums of these maxima
+			 */
+			void computeBounds();
+			void sumBounds();
+
+			/**
+			 * The grid of the dimensions not in mask; the factors of the others are replaced by the integrals of
+			 * the basis functions (values NULL) or by their values at values
+			 */
+			SparseGrid *project(int *mask, float *values);
+
+			/**
+			 * Frees the subspace table and the bounds (they are rebuilt by the next hierarchize)
+			 */
+			void releaseBounds();
+
+			/**
+			 * @return The number of level sums to evaluate for maxLevel and tol; bound receives the error bound
+			 */
+			int cutLevel(int maxLevel, float tol, float *bound) const;
+
 			int numOfGridPoints;
 			float *sg1d;
 			int d, l;
+			GridType type;
+			NumaPolicy numaPolicy;
+			int numaThreads;
+			Allocator *allocator;
+			AllocKind backing;
+			float **replicas;	/* one copy of sg1d per node (NUMA_REPLICATE) */
+			AllocKind *replicaBackings;
+			int *ranges;		/* the range of each thread (NUMA_PARTITION) */
+			int numSubspaces;
+			int *subspaceStart;	/* position of the first coefficient of every subspace, in sg1d order */
+			int *subspaceLevel;	/* level sum of every subspace */
+			float *maxSurplus;	/* max |coefficient| of every subspace (NULL before hierarchize) */
+			float *levelBounds;	/* sum of maxSurplus over the subspaces of level sum i or more */
+			int reorderMin;		/* see setReordering */
+			int hierarchized;	/* sg1d holds hierarchical coefficients rather than function values */
+			int external;		/* sg1d belongs to the caller (BUFFER_WRAP) */
 	};
 }
 
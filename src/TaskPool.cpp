@@ -0,0 +1,181 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2009, 2010 Alin Murarasu
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+#include "TaskPool.h"
+
+using namespace fsg;
+
+TaskPool::TaskPool()
+{
+	generation = 0;
+	active = 0;
+	running = 0;
+	stop = 0;
+	task = NULL;
+	arg = NULL;
+	queues.emplace_back();
+}
+
+TaskPool::~TaskPool()
+{
+	size_t w;
+
+	{
+		std::lock_guard<std::mutex> guard(state);
+		stop = 1;
+		wakeup.notify_all();
+	}
+	for (w = 0; w < workers.size(); w++)
+		workers[w].join();
+}
+
+TaskPool *TaskPool::shared()
+{
+	static TaskPool pool;
+
+	return &pool;
+}
+
+int TaskPool::getWorkers()
+{
+	std::lock_guard<std::mutex> guard(job);
+
+	return workers.size();
+}
+
+void TaskPool::run(int n, int threads, pool_task_t task, void *arg)
+{
+	std::unique_lock<std::mutex> busy(job, std::try_to_lock);
+	int t, w;
+
+	if (threads > n)
+		threads = n;
+	if (threads <= 1 || !busy.owns_lock()) {
+		/* a single thread, or the pool runs the job of another thread */
+		for (t = 0; t < n; t++)
+			task(t, arg);
+
+		return;
+	}
+
+	/* the workers are only started once; they are idle here, so the queues may grow */
+	while ((int) workers.size() < threads - 1) {
+		queues.emplace_back();
+		workers.push_back(std::thread(&TaskPool::work, this, (int) workers.size() + 1));
+	}
+	for (w = 0; w < threads; w++) {
+		queues[w].head = (long) n * w / threads;
+		queues[w].tail = (long) n * (w + 1) / threads;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(state);
+		this->task = task;
+		this->arg = arg;
+		active = threads;
+		running = threads - 1;
+		generation++;
+		wakeup.notify_all();
+	}
+
+	drain(0);
+
+	/* the queues are reused by the next job, so every participant has to be done with them */
+	std::unique_lock<std::mutex> lock(state);
+	done.wait(lock, [this]() { return running == 0; });
+}
+
+void TaskPool::work(int w)
+{
+	unsigned long seen = 0;
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(state);
+			wakeup.wait(lock, [this, w, &seen]() { return stop || (generation != seen && w < active); });
+			if (stop)
+				return;
+			seen = generation;
+		}
+
+		drain(w);
+
+		std::lock_guard<std::mutex> guard(state);
+		if (--running == 0)
+			done.notify_one();
+	}
+}
+
+void TaskPool::drain(int w)
+{
+	int t;
+
+	while ((t = next(w)) != -1)
+		task(t, arg);
+}
+
+/* the next task of worker w: its own, else the back half of the longest queue of another worker; -1 if none is left */
+int TaskPool::next(int w)
+{
+	int v, victim, most, mid, end;
+
+	{
+		std::lock_guard<std::mutex> guard(queues[w].lock);
+		if (queues[w].head < queues[w].tail)
+			return queues[w].head++;
+	}
+
+	while (1) {
+		victim = -1;
+		most = 0;
+		for (v = 0; v < active; v++) {
+			if (v == w)
+				continue;
+			std::lock_guard<std::mutex> guard(queues[v].lock);
+			if (queues[v].tail - queues[v].head > most) {
+				most = queues[v].tail - queues[v].head;
+				victim = v;
+			}
+		}
+		if (victim == -1)
+			return -1;
+
+		{
+			std::lock_guard<std::mutex> guard(queues[victim].lock);
+			if (queues[victim].head == queues[victim].tail)
+				continue;
+			end = queues[victim].tail;
+			mid = queues[victim].head + (end - queues[victim].head) / 2;
+			queues[victim].tail = mid;
+		}
+
+		/* the first stolen task is run now, the others are left where they can be stolen again */
+		std::lock_guard<std::mutex> guard(queues[w].lock);
+		queues[w].head = mid + 1;
+		queues[w].tail = end;
+
+		return mid;
+	}
+}
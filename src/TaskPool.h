@@ -0,0 +1,112 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2009, 2010 Alin Murarasu
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+#ifndef TASKPOOL_H_
+#define TASKPOOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fsg
+{
+	/* one task of a TaskPool run */
+	typedef void (*pool_task_t)(int t, void *arg);
+
+	/**
+	 * @class TaskPool
+	 *
+	 * @brief Persistent worker threads that run the tasks of one job at a time with work stealing
+	 *
+	 * The workers are created once, when a job first needs them, and sleep on a condition variable between jobs.
+	 * Every worker has its own queue of task numbers: a job gives each participant an equal share, a participant
+	 * takes tasks from the front of its queue and, when it is empty, steals the back half of the longest other
+	 * queue. The calling thread takes part as worker 0. If the pool is running the job of another thread, the
+	 * caller runs all its tasks itself rather than waiting.
+	 *
+	 */
+	class TaskPool
+	{
+		public:
+			/**
+			 * Class constructor; no thread is started yet
+			 */
+			TaskPool();
+
+			/**
+			 * Class destructor; stops and joins the workers
+			 */
+			virtual ~TaskPool();
+
+			/**
+			 * Runs task(t, arg) for t = 0 .. n - 1 and returns when all of them are done
+			 * @param n Number of tasks
+			 * @param threads Number of threads, the calling one included
+			 * @param task The function called for every task
+			 * @param arg Passed to task
+			 */
+			void run(int n, int threads, pool_task_t task, void *arg);
+
+			/**
+			 * @return The number of worker threads started so far (the callers are not counted)
+			 */
+			int getWorkers();
+
+			/**
+			 * @return The pool shared by all the sparse grids of the process
+			 */
+			static TaskPool *shared();
+
+		private:
+			TaskPool(const TaskPool &);
+			TaskPool &operator=(const TaskPool &);
+
+			/* the tasks [head, tail) of a worker; it takes them from the front, the others steal from the back */
+			typedef struct steal_queue_t {
+				std::mutex lock;
+				int head, tail;
+			} steal_queue_t;
+
+			void work(int w);
+			void drain(int w);
+			int next(int w);
+
+			std::mutex job;			/* held by the thread whose job runs */
+			std::mutex state;		/* guards the fields below */
+			std::condition_variable wakeup, done;
+			unsigned long generation;	/* number of jobs started */
+			int active;			/* participants of the current job, the caller included */
+			int running;			/* workers still busy with the current job */
+			int stop;
+			pool_task_t task;
+			void *arg;
+			std::deque<steal_queue_t> queues;
+			std::vector<std::thread> workers;
+	};
+}
+
+#endif /* TASKPOOL_H_ */
@@ -0,0 +1,203 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2009, 2010 Alin Murarasu
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+#include "VersionedSparseGrid.h"
+
+#include <set>
+#include <thread>
+
+using namespace fsg;
+
+/* read-side state of one thread; epoch is 0 while the thread is not reading */
+typedef struct rcu_slot_t {
+	std::atomic<unsigned long> epoch;
+	int depth;
+} rcu_slot_t;
+
+/* the slots of the live threads and the global epoch, shared by all handles */
+typedef struct rcu_registry_t {
+	std::mutex lock;
+	std::set<rcu_slot_t *> slots;
+	std::atomic<unsigned long> epoch;
+} rcu_registry_t;
+
+static rcu_registry_t *registry()
+{
+	/* never destroyed, so threads exiting after main can still unregister */
+	static rcu_registry_t *r = new rcu_registry_t();
+
+	return r;
+}
+
+class RcuThreadSlot
+{
+	public:
+		rcu_slot_t slot;
+
+		RcuThreadSlot()
+		{
+			rcu_registry_t *r = registry();
+
+			slot.epoch.store(0);
+			slot.depth = 0;
+
+			std::lock_guard<std::mutex> guard(r->lock);
+			r->slots.insert(&slot);
+		}
+
+		~RcuThreadSlot()
+		{
+			rcu_registry_t *r = registry();
+
+			std::lock_guard<std::mutex> guard(r->lock);
+			r->slots.erase(&slot);
+		}
+};
+
+static rcu_slot_t *local()
+{
+	static thread_local RcuThreadSlot slot;
+
+	return &slot.slot;
+}
+
+/* deletes the grids retired before every active reader started; returns the number left */
+static int reclaim_retired(std::vector<std::pair<SparseGrid *, unsigned long> > &retired)
+{
+	rcu_registry_t *r = registry();
+	std::set<rcu_slot_t *>::iterator it;
+	unsigned long oldest = ~0UL, e;
+	size_t i, j;
+
+	{
+		std::lock_guard<std::mutex> guard(r->lock);
+		for (it = r->slots.begin(); it != r->slots.end(); ++it) {
+			e = (*it)->epoch.load();
+			if (e != 0 && e < oldest)
+				oldest = e;
+		}
+	}
+
+	/* a reader that can still see a grid retired at epoch t announced an epoch < t */
+	for (i = 0, j = 0; i < retired.size(); i++) {
+		if (retired[i].second <= oldest)
+			delete retired[i].first;
+		else
+			retired[j++] = retired[i];
+	}
+	retired.resize(j);
+
+	return j;
+}
+
+VersionedSparseGrid::VersionedSparseGrid(SparseGrid *grid)
+{
+	rcu_registry_t *r = registry();
+	unsigned long e = 0;
+
+	/* the global epoch starts at 1, 0 marks the idle slots */
+	r->epoch.compare_exchange_strong(e, 1);
+	current.store(grid);
+	version.store(1);
+}
+
+VersionedSparseGrid::~VersionedSparseGrid()
+{
+	size_t i;
+
+	for (i = 0; i < retired.size(); i++)
+		delete retired[i].first;
+	delete current.load();
+}
+
+const SparseGrid *VersionedSparseGrid::acquire()
+{
+	rcu_slot_t *s = local();
+
+	/* announce the epoch before loading the pointer; both are sequentially consistent */
+	if (s->depth++ == 0)
+		s->epoch.store(registry()->epoch.load());
+
+	return current.load();
+}
+
+void VersionedSparseGrid::release()
+{
+	rcu_slot_t *s = local();
+
+	if (--s->depth == 0)
+		s->epoch.store(0, std::memory_order_release);
+}
+
+float VersionedSparseGrid::evaluate(float *coords)
+{
+	float val = acquire()->evaluate(coords);
+
+	release();
+
+	return val;
+}
+
+int VersionedSparseGrid::evaluate(float *coords, int n, float *vals)
+{
+	int ret = acquire()->evaluate(coords, n, vals);
+
+	release();
+
+	return ret;
+}
+
+long VersionedSparseGrid::publish(SparseGrid *grid)
+{
+	std::lock_guard<std::mutex> guard(writer);
+	SparseGrid *old;
+	unsigned long e;
+
+	old = current.exchange(grid);
+	/* readers announcing this epoch or a later one started after the exchange */
+	e = registry()->epoch.fetch_add(1) + 1;
+	retired.push_back(std::make_pair(old, e));
+	reclaim_retired(retired);
+
+	return ++version;
+}
+
+int VersionedSparseGrid::reclaim()
+{
+	std::lock_guard<std::mutex> guard(writer);
+
+	return reclaim_retired(retired);
+}
+
+void VersionedSparseGrid::synchronize()
+{
+	while (reclaim() > 0)
+		std::this_thread::yield();
+}
+
+long VersionedSparseGrid::getVersion()
+{
+	return version.load();
+}
@@ -0,0 +1,123 @@
+/**********************************************************************************
+ *
+ * Copyright (c) 2009, 2010 Alin Murarasu
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * For any other enquiries send an email to Alin Murarasu, murarasu@in.tum.de.
+ *
+ * When publishing work that is based on this program please cite:
+ * A. Murarasu, J. Weidendorfer, G. Buse, D. Butnaru, and D. Pflueger:
+ * "Compact Data Structure and Scalable Algorithms for the Sparse Grid Technique"
+ * PPoPP, Feb. 2011
+ *
+ *********************************************************************************/
+
+#ifndef VERSIONEDSPARSEGRID_H_
+#define VERSIONEDSPARSEGRID_H_
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "SparseGrid.h"
+
+namespace fsg
+{
+	/**
+	 * @class VersionedSparseGrid
+	 *
+	 * @brief Handle to a sparse grid whose coefficients can be replaced while other threads evaluate it
+	 *
+	 * The published grid is an immutable snapshot. Readers do not take locks: a read announces the current
+	 * epoch in a per-thread slot, loads the snapshot pointer and clears the slot when done. A writer publishes a
+	 * new grid with one atomic exchange and retires the old one; a retired grid is deleted once no reader that
+	 * could still see it is active (epoch based reclamation). Only the writers synchronize among themselves.
+	 *
+	 */
+	class VersionedSparseGrid
+	{
+		public:
+			/**
+			 * Class constructor
+			 * @param grid The first version; the handle takes ownership
+			 */
+			VersionedSparseGrid(SparseGrid *grid);
+
+			/**
+			 * Class destructor; deletes all versions, so no reader may be active
+			 */
+			virtual ~VersionedSparseGrid();
+
+			/**
+			 * @param coords The point at which we evaluate (interpolate) the current version
+			 * @return The result of the evaluation
+			 */
+			float evaluate(float *coords);
+
+			/**
+			 * @param coords The set of points at which we evaluate (interpolate) the current version
+			 * @param n The size of the set
+			 * @param vals The results of the evaluation, all computed with the same version
+			 * @return Returns 0 if successfull
+			 */
+			int evaluate(float *coords, int n, float *vals);
+
+			/**
+			 * Pins the current version for the calling thread until the matching release, e.g. to run several
+			 * queries against the same snapshot; calls may be nested. The version is read-only (only its const methods).
+			 * @return The current version
+			 */
+			const SparseGrid *acquire();
+
+			/**
+			 * Ends the innermost acquire of the calling thread
+			 */
+			void release();
+
+			/**
+			 * Makes grid the current version; never blocks the readers
+			 * @param grid The new version, with hierarchical coefficients; the handle takes ownership
+			 * @return The number of the new version
+			 */
+			long publish(SparseGrid *grid);
+
+			/**
+			 * Deletes the retired versions that no reader can use anymore
+			 * @return The number of retired versions still in use
+			 */
+			int reclaim();
+
+			/**
+			 * Waits until all retired versions are deleted (the readers keep running); the calling thread
+			 * must not hold an acquire
+			 */
+			void synchronize();
+
+			/**
+			 * @return The number of the current version (1 for the grid given to the constructor)
+			 */
+			long getVersion();
+
+		private:
+			VersionedSparseGrid(const VersionedSparseGrid &);
+			VersionedSparseGrid &operator=(const VersionedSparseGrid &);
+
+			std::atomic<SparseGrid *> current;
+			std::atomic<long> version;
+			std::mutex writer;
+			std::vector<std::pair<SparseGrid *, unsigned long> > retired;	/* grid and epoch of its retirement */
+	};
+}
+
+#endif /* VERSIONEDSPARSEGRID_H_ */